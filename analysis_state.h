@@ -0,0 +1,358 @@
+// ============================================================================
+// ANALYSIS STATE - Incremental analysis of append-only captures
+// ============================================================================
+// A capture that keeps growing shouldn't be re-read from the start every
+// time. Everything freq_analysis and kasiski_attack report can be kept as
+// running totals that only ever grow:
+//
+//   letter counts           - for the frequency table
+//   column counts           - letters per column for a few base periods;
+//                             any key length dividing one of them folds
+//                             out of it (see choose_base_periods)
+//   last-seen positions     - of every trigram and tetragram, so each new
+//                             occurrence yields its distance to the last
+//   distance residues       - distance mod each base period, from which
+//                             "how many distances does f divide" follows
+//                             for every key length f
+//
+// `--state FILE` saves these after each run. The next run skips the bytes
+// it already saw and processes only what was appended, so its cost
+// depends on the new data, not the size of the capture.
+// ============================================================================
+
+#ifndef ANALYSIS_STATE_H
+#define ANALYSIS_STATE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <numeric>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "arena.h"
+#include "base_periods.h"
+#include "cipher.h"
+#include "cipher_io.h"
+
+
+// Every state file starts with these 8 bytes
+const char STATE_MAGIC[8] = {'C', 'I', 'P', 'H', 'S', 'T', 'A', '1'};
+
+// How many of the last processed bytes are kept to recognise the capture
+const size_t STATE_TAIL_BYTES = 64;
+
+// Bytes update() works through at a time
+const size_t STATE_BLOCK = 1 << 16;
+
+// Key lengths a state made by freq_analysis tracks
+const int DEFAULT_STATE_MAX_KEY = 40;
+
+// Longest key length a state may track: the column counts grow with the
+// square of it (40 → 5 MB, 200 → 15 MB, 1000 → 114 MB on disk)
+const int MAX_STATE_KEY = 200;
+
+
+class AnalysisState {
+public:
+    explicit AnalysisState(int max_key_len = DEFAULT_STATE_MAX_KEY) { reset(max_key_len); }
+
+
+    // Loads a state file; returns false if there is none yet
+    // A file that exists but isn't a state file is an error
+    bool load(const std::string& filename) {
+        struct stat info;
+        if (::stat(filename.c_str(), &info) != 0) return false;
+
+        MappedInput input(filename);
+        Reader reader{input.data(), input.data() + input.size()};
+
+        char magic[8] = {};
+        reader.read(magic, sizeof(magic));
+        if (!reader.ok || std::memcmp(magic, STATE_MAGIC, sizeof(magic)) != 0) {
+            fail(filename);
+        }
+
+        uint32_t max_key_len = 0;
+        reader.read(&max_key_len, sizeof(max_key_len));
+        if (!reader.ok || max_key_len < 1 || max_key_len > MAX_STATE_KEY) fail(filename);
+        reset(static_cast<int>(max_key_len));
+
+        reader.read(&bytes_, sizeof(bytes_));
+        reader.read(&letters_, sizeof(letters_));
+        reader.read(&distances_, sizeof(distances_));
+        reader.read(&gcd_all_, sizeof(gcd_all_));
+        reader.read(&recent_, sizeof(recent_));
+        reader.read(letter_counts_, sizeof(letter_counts_));
+        reader.read(tail_, sizeof(tail_));
+        reader.read(columns_.data(), columns_.size() * sizeof(uint64_t));
+        reader.read(residues_.data(), residues_.size() * sizeof(uint64_t));
+        reader.read(last_seen_3_.data(), last_seen_3_.size() * sizeof(uint64_t));
+        reader.read(last_seen_4_.data(), last_seen_4_.size() * sizeof(uint64_t));
+
+        if (!reader.ok || reader.next != reader.end) fail(filename);
+        return true;
+    }
+
+
+    // Writes the state to a temporary file, then renames it over the old
+    // one - a crash mid-write never leaves a half-written state behind
+    void save(const std::string& filename) const {
+        std::string temporary = filename + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            uint32_t max_key_len = static_cast<uint32_t>(max_key_len_);
+
+            out.write(STATE_MAGIC, sizeof(STATE_MAGIC));
+            write(out, &max_key_len, sizeof(max_key_len));
+            write(out, &bytes_, sizeof(bytes_));
+            write(out, &letters_, sizeof(letters_));
+            write(out, &distances_, sizeof(distances_));
+            write(out, &gcd_all_, sizeof(gcd_all_));
+            write(out, &recent_, sizeof(recent_));
+            write(out, letter_counts_, sizeof(letter_counts_));
+            write(out, tail_, sizeof(tail_));
+            write(out, columns_.data(), columns_.size() * sizeof(uint64_t));
+            write(out, residues_.data(), residues_.size() * sizeof(uint64_t));
+            write(out, last_seen_3_.data(), last_seen_3_.size() * sizeof(uint64_t));
+            write(out, last_seen_4_.data(), last_seen_4_.size() * sizeof(uint64_t));
+
+            if (!out) {
+                std::cerr << "Error: Could not write to file " << temporary << std::endl;
+                exit(1);
+            }
+        }
+        if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+            std::cerr << "Error: Could not write to file " << filename << std::endl;
+            exit(1);
+        }
+    }
+
+
+    // The part of a capture file this state hasn't seen yet
+    // The file must still start with what was processed before: it may
+    // only have grown, and the last bytes seen must still be in place
+    std::span<const char> new_bytes(std::string_view capture, const std::string& name) const {
+        if (capture.size() < bytes_) {
+            std::cerr << "Error: " << name << " is shorter than the state file says ("
+                      << capture.size() << " < " << bytes_ << " bytes) - start a new state file"
+                      << std::endl;
+            exit(1);
+        }
+
+        size_t kept = std::min<uint64_t>(bytes_, STATE_TAIL_BYTES);
+        if (std::memcmp(capture.data() + bytes_ - kept, tail_ + STATE_TAIL_BYTES - kept, kept) != 0) {
+            std::cerr << "Error: " << name << " doesn't match the state file"
+                      << " - start a new state file" << std::endl;
+            exit(1);
+        }
+
+        return std::span<const char>(capture.data() + bytes_, capture.size() - bytes_);
+    }
+
+
+    // Adds newly appended bytes to every running total
+    // Works a block at a time, like columnar_ic: first the letters and
+    // repeat distances of the block are collected, then each base period
+    // walks over them while its own counters are hot in cache
+    void update(std::span<const char> data) {
+        const uint8_t* bin = LETTER_BINS.bin;
+        std::vector<uint8_t> letters;
+        std::vector<uint64_t> distances;
+        letters.reserve(STATE_BLOCK);
+
+        for (size_t start = 0; start < data.size(); start += STATE_BLOCK) {
+            size_t end = std::min(data.size(), start + STATE_BLOCK);
+            uint64_t first_letter = letters_;
+            letters.clear();
+            distances.clear();
+
+            for (size_t i = start; i < end; i++) {
+                uint8_t pos = bin[static_cast<uint8_t>(data[i])];
+                if (pos == 26) continue;
+                letters.push_back(pos);
+                letter_counts_[pos]++;
+
+                // Trigram and tetragram ending at this letter
+                recent_ = (recent_ % 17576) * 26 + pos;
+                letters_++;
+                if (letters_ >= 3) add_occurrence(last_seen_3_[recent_ % 17576], distances);
+                if (letters_ >= 4) add_occurrence(last_seen_4_[recent_], distances);
+            }
+
+            for (size_t b = 0; b < bases_.size(); b++) {
+                uint64_t* table = columns_.data() + column_offset_[b];
+                int period = bases_[b];
+                int col = static_cast<int>(first_letter % period);
+                for (uint8_t pos : letters) {
+                    table[col * 26 + pos]++;
+                    if (++col == period) col = 0;
+                }
+
+                uint64_t* residue = residues_.data() + residue_offset_[b];
+                uint64_t magic = UINT64_MAX / period + 1;
+                // fast_remainder: a division here would dominate update()
+                for (uint64_t distance : distances) {
+                    residue[fast_remainder(distance, period, magic)]++;
+                }
+            }
+        }
+
+        // Remember the last bytes, to recognise the capture next time
+        size_t keep = std::min(data.size(), STATE_TAIL_BYTES);
+        std::memmove(tail_, tail_ + keep, STATE_TAIL_BYTES - keep);
+        std::memcpy(tail_ + STATE_TAIL_BYTES - keep, data.data() + data.size() - keep, keep);
+        bytes_ += data.size();
+    }
+
+
+    // Input bytes and letters processed so far
+    uint64_t bytes() const { return bytes_; }
+    uint64_t letters() const { return letters_; }
+    int max_key_len() const { return max_key_len_; }
+    const uint64_t* letter_counts() const { return letter_counts_; }
+
+
+    // Distances between consecutive trigram/tetragram repeats
+    uint64_t distances() const { return distances_; }
+    uint64_t gcd_all() const { return gcd_all_; }
+
+    // How many of those distances key length f divides
+    uint64_t divisible_by(int f) const {
+        size_t b = base_for(f);
+        const uint64_t* residue = residues_.data() + residue_offset_[b];
+
+        uint64_t count = 0;
+        for (int r = 0; r < bases_[b]; r += f) count += residue[r];
+        return count;
+    }
+
+
+    // Letter counts of every column for one key length (col * 26 + letter)
+    std::vector<uint64_t> column_counts(int key_length) const {
+        size_t b = base_for(key_length);
+        const uint64_t* source = columns_.data() + column_offset_[b];
+
+        std::vector<uint64_t> folded(static_cast<size_t>(key_length) * 26, 0);
+        for (int col = 0; col < bases_[b]; col++) {
+            uint64_t* target = folded.data() + (col % key_length) * 26;
+            for (int c = 0; c < 26; c++) target[c] += source[col * 26 + c];
+        }
+        return folded;
+    }
+
+
+    // Average IC of the columns for one key length
+    double average_ic(int key_length) const {
+        std::vector<uint64_t> counts = column_counts(key_length);
+        double total_ic = 0.0;
+
+        for (int col = 0; col < key_length; col++) {
+            uint64_t total = 0;
+            double sum = 0.0;
+            for (int c = 0; c < 26; c++) {
+                double n = static_cast<double>(counts[col * 26 + c]);
+                total += counts[col * 26 + c];
+                sum += n * (n - 1);
+            }
+            if (total >= 2) total_ic += sum / (static_cast<double>(total) * (total - 1));
+        }
+        return total_ic / key_length;
+    }
+
+private:
+    struct Reader {
+        const char* next;
+        const char* end;
+        bool ok = true;
+
+        void read(void* target, size_t size) {
+            if (static_cast<size_t>(end - next) < size) {
+                ok = false;
+                return;
+            }
+            std::memcpy(target, next, size);
+            next += size;
+        }
+    };
+
+    static void write(std::ofstream& out, const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+
+    [[noreturn]] static void fail(const std::string& filename) {
+        std::cerr << "Error: " << filename << " is not a state file" << std::endl;
+        exit(1);
+    }
+
+
+    void reset(int max_key_len) {
+        max_key_len_ = max_key_len;
+        bases_ = choose_base_periods(max_key_len);
+
+        column_offset_.clear();
+        residue_offset_.clear();
+        size_t columns = 0, residues = 0;
+        for (int period : bases_) {
+            column_offset_.push_back(columns);
+            residue_offset_.push_back(residues);
+            columns += static_cast<size_t>(period) * 26;
+            residues += period;
+        }
+
+        columns_.assign(columns, 0);
+        residues_.assign(residues, 0);
+        last_seen_3_.assign(26 * 26 * 26, 0);
+        last_seen_4_.assign(26 * 26 * 26 * 26, 0);
+        std::fill(letter_counts_, letter_counts_ + 26, 0);
+        std::fill(tail_, tail_ + STATE_TAIL_BYTES, 0);
+        bytes_ = letters_ = distances_ = gcd_all_ = 0;
+        recent_ = 0;
+    }
+
+
+    // First base period that key length f divides
+    size_t base_for(int f) const { return base_period_for(bases_, f); }
+
+
+    // An n-gram just ended at letter letters_ - 1
+    // last_seen holds where it last ended (+1, so 0 = never)
+    void add_occurrence(uint64_t& last_seen, std::vector<uint64_t>& distances) {
+        uint64_t position = letters_;
+        if (last_seen != 0) {
+            uint64_t distance = position - last_seen;
+            distances.push_back(distance);
+            distances_++;
+            if (gcd_all_ != 1) gcd_all_ = std::gcd(gcd_all_, distance);
+        }
+        last_seen = position;
+    }
+
+
+    int max_key_len_ = 0;
+    std::vector<int> bases_;
+    std::vector<size_t> column_offset_;   // Where each base's columns start
+    std::vector<size_t> residue_offset_;  // Where each base's residues start
+
+    uint64_t bytes_ = 0;      // Input bytes processed
+    uint64_t letters_ = 0;    // Letters among them
+    uint64_t distances_ = 0;  // Repeat distances seen
+    uint64_t gcd_all_ = 0;    // GCD of all of them (0 = none yet)
+    uint32_t recent_ = 0;     // Code of the last 4 letters
+    uint64_t letter_counts_[26];
+    char tail_[STATE_TAIL_BYTES];  // Last bytes processed, right-aligned
+
+    std::vector<uint64_t> columns_;      // Per base: period × 26 letter counts
+    std::vector<uint64_t> residues_;     // Per base: distances by (distance mod period)
+    std::vector<uint64_t> last_seen_3_;  // Per trigram: letter index after it (0 = never)
+    std::vector<uint64_t> last_seen_4_;  // Per tetragram: same
+};
+
+#endif  // ANALYSIS_STATE_H
@@ -0,0 +1,136 @@
+// ============================================================================
+// ARENA - Scratch Memory Thrown Away All at Once
+// ============================================================================
+// Cracking one short message allocates dozens of small buffers that are
+// all dead by the time the next message starts: column counts, IC
+// tables, trial plaintexts... With millions of messages, malloc and free
+// become a large part of the run time.
+//
+// An arena hands memory out by bumping a pointer through one big block
+// and frees nothing on its own - when the message is done, the whole
+// block is rewound in one step:
+//
+//   ArenaScope scope;                           // one per message (or task)
+//   std::pmr::vector<uint32_t> counts(scratch());  // from this thread's arena
+//
+// Every thread has its own arena, so workers never share or lock one.
+// Scopes nest: a worker waiting inside parallel_for may pick up another
+// message, and memory is only rewound when the outermost scope on that
+// thread ends. Outside any scope, scratch() is plain new/delete, so code
+// that runs once (the interactive mode, the benchmarks) behaves as before.
+//
+// The block starts at ARENA_INITIAL_BYTES. A message that needs more
+// gets the overflow from new, and at the rewind the block grows to cover
+// it - after the first few messages, each one fits and malloc is never
+// called. Only containers that live and die inside a scope may use
+// scratch(); results that outlive the message use the normal allocator.
+// ============================================================================
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+
+const size_t ARENA_INITIAL_BYTES = size_t(256) << 10;  // 256 KB per thread to start with
+const size_t ARENA_MAX_BYTES = size_t(64) << 20;       // Growth stops here; bigger messages use new
+
+
+class ScratchArena {
+public:
+    // The calling thread's arena
+    static ScratchArena& this_thread() {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    std::pmr::memory_resource* resource() {
+        return depth_ > 0 ? &*resource_ : std::pmr::new_delete_resource();
+    }
+
+    void enter() { depth_++; }
+
+    void leave() {
+        if (--depth_ == 0) rewind();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+private:
+    // Where the arena goes when its block is full - counts how much it
+    // took, so the block can grow to fit next time
+    class Overflow : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+        void do_deallocate(void* p, size_t size, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    ScratchArena() { allocate_block(ARENA_INITIAL_BYTES); }
+
+    void allocate_block(size_t size) {
+        resource_.reset();
+        capacity_ = size;
+        block_ = std::make_unique<std::byte[]>(size);
+        resource_.emplace(block_.get(), size, &overflow_);
+    }
+
+    // O(1) unless the message overflowed: then the block is replaced by
+    // one big enough for it
+    void rewind() {
+        resource_->release();
+        if (overflow_.bytes > 0 && capacity_ < ARENA_MAX_BYTES) {
+            allocate_block(std::min(ARENA_MAX_BYTES, capacity_ + overflow_.bytes));
+        }
+        overflow_.bytes = 0;
+    }
+
+    int depth_ = 0;
+    size_t capacity_ = 0;
+    Overflow overflow_;
+    std::unique_ptr<std::byte[]> block_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+};
+
+
+// Scratch memory for the current thread: its arena inside an ArenaScope,
+// new/delete outside of one
+
+inline std::pmr::memory_resource* scratch() {
+    return ScratchArena::this_thread().resource();
+}
+
+
+// Everything allocated from scratch() while the outermost scope on this
+// thread is alive is released when it ends
+
+class ArenaScope {
+public:
+    ArenaScope() : arena_(ScratchArena::this_thread()) { arena_.enter(); }
+    ~ArenaScope() { arena_.leave(); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    ScratchArena& arena_;
+};
+
+#endif  // ARENA_H
@@ -0,0 +1,92 @@
+// ============================================================================
+// BASE PERIODS - Every Key Length from a Few Tables
+// ============================================================================
+// Counts kept per key length (column letter counts, repeat distances by
+// remainder) add up: the counts for key length L follow from the counts
+// for any multiple M of L. So instead of one table per key length, only a
+// few "base periods" are kept, chosen so that every length 1..max_length
+// divides at least one of them. columnar_ic (kasiski.h) and AnalysisState
+// (analysis_state.h) both work this way.
+// ============================================================================
+
+#ifndef BASE_PERIODS_H
+#define BASE_PERIODS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "arena.h"
+
+
+// Largest base period to count directly
+// 4096 columns × 26 counters × 4 bytes ≈ 425 KB, small enough for L2 cache
+const int MAX_BASE_PERIOD = 4096;
+
+
+// Picks the periods whose column counts are actually kept
+// Counts for key length L can be added up from the counts of any multiple
+// M of L: column j of L is the sum of columns j, j+L, j+2L, ... of M.
+// So we only need periods whose divisors cover 1..max_length. 120 alone
+// covers 16 key lengths (1, 2, 3, 4, 5, 6, 8, 10, 12, 15, 20, 24, ...).
+// Greedy: keep picking the period that covers the most uncovered lengths.
+// `max_period` caps the periods below MAX_BASE_PERIOD: columnar_ic passes
+// the text length, since a period longer than the text is mostly empty
+// columns. (At 15 key lengths the first pick would be 2520, a 262 KB
+// table, for a 100-letter message.) No cap goes below max_length.
+
+inline std::vector<int> choose_base_periods(int max_length, int max_period = MAX_BASE_PERIOD) {
+    int limit = std::max(max_length, std::min(max_period, MAX_BASE_PERIOD));
+    std::pmr::vector<bool> covered(max_length + 1, false, scratch());
+    std::vector<int> bases;
+    int remaining = max_length;
+
+    // score[M] = uncovered key lengths that divide M
+    std::pmr::vector<int> score(limit + 1, 0, scratch());
+
+    while (remaining > 0) {
+        std::fill(score.begin(), score.end(), 0);
+        for (int len = 1; len <= max_length; len++) {
+            if (covered[len]) continue;
+            for (int m = len; m <= limit; m += len) score[m]++;
+        }
+
+        int best = static_cast<int>(std::max_element(score.begin(), score.end()) - score.begin());
+        bases.push_back(best);
+
+        for (int len = 1; len <= max_length; len++) {
+            if (!covered[len] && best % len == 0) {
+                covered[len] = true;
+                remaining--;
+            }
+        }
+    }
+
+    return bases;
+}
+
+
+// Index of the first base period that key length f divides
+
+inline size_t base_period_for(const std::vector<int>& bases, int f) {
+    size_t b = 0;
+    while (bases[b] % f != 0) b++;
+    return b;
+}
+
+
+// value % period without a division (Lemire's fastmod)
+// magic = 2^64 / period, rounded up (UINT64_MAX / period + 1). Its product
+// with the value is the fractional part of value / period, and multiplying
+// that back by the period gives the remainder - exact for 32-bit values,
+// and several times faster than the division it replaces
+
+inline uint64_t fast_remainder(uint64_t value, int period, uint64_t magic) {
+    if (value > UINT32_MAX) return value % period;
+    uint64_t fraction = magic * value;
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(fraction) * period) >> 64);
+}
+
+#endif  // BASE_PERIODS_H
@@ -0,0 +1,421 @@
+// ============================================================================
+// BENCHMARK - Timing the Hot Paths
+// ============================================================================
+// Runs the functions the tools spend their time in over synthetic inputs
+// from 1 KB up to 1 GB and prints one JSON object per line and size:
+//
+//   {"benchmark":"calculate_ic","bytes":1048576,"iterations":64,
+//    "seconds":0.21,"mb_per_s":319.5,"ns_per_byte":3.13,
+//    "allocations":1.0,"allocated_bytes":1048576.0,"peak_rss_kb":9120,...}
+//
+//   mb_per_s / ns_per_byte  - average over all iterations (MB = 10^6 bytes)
+//   allocations, bytes      - per call, counted by the operator new in
+//                             kasiski_stats.h
+//   peak_rss_kb             - highest resident memory during the benchmark,
+//                             inputs included
+//
+// Inputs are generated, not read: English-like text drawn from a list of
+// common words, and Vigenère ciphertext of it with a known key. Every run
+// uses the same seed, so results from different builds compare directly.
+//
+// Compile:
+//   cmake -S . -B build && cmake --build build --target benchmark
+// Run:
+//   ./benchmark                          (1 KB - 64 MB)
+//   ./benchmark --max-size 1G > run.json
+//   ./benchmark --only calculate_ic,recover_key --min-time 1
+// ============================================================================
+
+// Allocations per call come from the operator new in kasiski_stats.h
+#define KASISKI_COUNT_ALLOCATIONS_HERE
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "cipher.h"
+#include "kasiski.h"
+
+
+// ============================================================================
+// PEAK MEMORY
+// ============================================================================
+
+// Resets the peak resident set size to the current one
+// Linux only: writing 5 to clear_refs resets VmHWM. Without it, the peak
+// only ever grows and the big sizes hide the small ones.
+
+bool reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    return static_cast<bool>(clear_refs);
+}
+
+
+// Peak resident set size in KB since the last reset
+// Falls back to getrusage, which never resets
+
+long peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::atol(line.c_str() + 6);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+
+// ============================================================================
+// INPUT GENERATORS
+// ============================================================================
+
+// The 100 most common English words, most common first
+// Drawn with weight 1 / rank (Zipf's law), which gives roughly English
+// letter frequencies and plenty of repeated sequences for Kasiski
+const char* const COMMON_WORDS[] = {
+    "the", "of", "and", "to", "a", "in", "is", "you", "that", "it",
+    "he", "was", "for", "on", "are", "as", "with", "his", "they", "at",
+    "be", "this", "have", "from", "or", "one", "had", "by", "word", "but",
+    "not", "what", "all", "were", "we", "when", "your", "can", "said", "there",
+    "use", "an", "each", "which", "she", "do", "how", "their", "if", "will",
+    "up", "other", "about", "out", "many", "then", "them", "these", "so", "some",
+    "her", "would", "make", "like", "him", "into", "time", "has", "look", "two",
+    "more", "write", "go", "see", "number", "no", "way", "could", "people", "my",
+    "than", "first", "water", "been", "call", "who", "oil", "its", "now", "find",
+    "long", "down", "day", "did", "get", "come", "made", "may", "part", "over",
+};
+
+const uint32_t BENCHMARK_SEED = 1863;  // The year Kasiski published
+const char* const BENCHMARK_KEY = "KASISKI";
+const int BENCHMARK_SHIFT = 11;
+
+
+// English-like text of exactly `size` bytes
+// letters_only: uppercase letters and nothing else, like clean_text output
+// Otherwise lowercase words with spaces, a sentence break every 12 words
+
+std::string english_text(size_t size, bool letters_only) {
+    const size_t WORDS = sizeof(COMMON_WORDS) / sizeof(COMMON_WORDS[0]);
+    std::vector<double> weights;
+    for (size_t rank = 1; rank <= WORDS; rank++) weights.push_back(1.0 / rank);
+
+    std::mt19937 rng(BENCHMARK_SEED);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+    std::string text;
+    text.reserve(size + 16);
+    size_t words = 0;
+
+    while (text.size() < size) {
+        for (const char* c = COMMON_WORDS[pick(rng)]; *c; c++) {
+            text += letters_only ? static_cast<char>(*c - 'a' + 'A') : *c;
+        }
+        if (!letters_only) text += ++words % 12 == 0 ? ".\n" : " ";
+    }
+
+    text.resize(size);
+    return text;
+}
+
+
+// What one size's benchmarks run on
+// Generated when a benchmark first asks for it. Only one input is kept at
+// a time, so even 1 GB sizes fit in memory; the benchmarks are ordered so
+// each input is generated once per size
+
+struct Inputs {
+    size_t size;
+    std::string plaintext;   // English-like, with spaces and punctuation
+    std::string ciphertext;  // Cleaned Vigenère ciphertext, key BENCHMARK_KEY
+    std::string column;      // Cleaned Caesar ciphertext, shift BENCHMARK_SHIFT
+
+    const std::string& text() {
+        if (plaintext.empty()) {
+            release();
+            plaintext = english_text(size, false);
+        }
+        return plaintext;
+    }
+
+    const std::string& cipher() {
+        if (ciphertext.empty()) {
+            release();
+            ciphertext = vigenere_encrypt(english_text(size, true), BENCHMARK_KEY);
+        }
+        return ciphertext;
+    }
+
+    const std::string& caesar() {
+        if (column.empty()) {
+            release();
+            column = caesar_encrypt(english_text(size, true), BENCHMARK_SHIFT);
+        }
+        return column;
+    }
+
+    void release() {
+        std::string().swap(plaintext);
+        std::string().swap(ciphertext);
+        std::string().swap(column);
+    }
+};
+
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+// Keeps results alive so the compiler can't drop the calls being timed
+volatile uint64_t sink = 0;
+
+
+struct Benchmark {
+    const char* name;
+    size_t max_bytes;  // Larger inputs would need too much memory
+    std::function<void(Inputs&, int iterations)> run;  // Prepares inputs when iterations == 0
+};
+
+
+const size_t GB = size_t(1) << 30;
+
+std::vector<Benchmark> make_benchmarks() {
+    return {
+        {"caesar_encrypt", GB, [](Inputs& in, int iterations) {
+            const std::string& text = in.text();
+            for (int i = 0; i < iterations; i++) sink = caesar_encrypt(text, 3).back();
+        }},
+        {"vigenere_process", GB, [](Inputs& in, int iterations) {
+            const std::string& text = in.text();
+            for (int i = 0; i < iterations; i++) {
+                sink = vigenere_process(text, BENCHMARK_KEY, 1).back();
+            }
+        }},
+        {"count_letters", GB, [](Inputs& in, int iterations) {
+            const std::string& text = in.text();
+            uint64_t counts[26];
+            for (int i = 0; i < iterations; i++) {
+                count_letters(text, counts);
+                sink = counts[4];
+            }
+        }},
+        {"calculate_ic", GB, [](Inputs& in, int iterations) {
+            const std::string& text = in.cipher();
+            for (int i = 0; i < iterations; i++) {
+                sink = static_cast<uint64_t>(calculate_ic(text) * 1e6);
+            }
+        }},
+        // The positions array holds one int per repeated tetragram occurrence
+        {"find_repeated_sequences", GB / 4, [](Inputs& in, int iterations) {
+            const std::string& text = in.cipher();
+            for (int i = 0; i < iterations; i++) sink = find_repeated_sequences(text, 4).size();
+        }},
+        // Shifts up to 4 × 1000 over at most PERIOD_SAMPLE letters, so this
+        // levels off past the first MB
+        {"find_period", GB, [](Inputs& in, int iterations) {
+            const std::string& text = in.cipher();
+            int limit = period_search_limit(text.length(), 15);
+            for (int i = 0; i < iterations; i++) sink = find_period(text, limit).best;
+        }},
+        {"recover_key", GB, [](Inputs& in, int iterations) {
+            const std::string& text = in.cipher();
+            int key_length = static_cast<int>(std::string(BENCHMARK_KEY).length());
+
+            // recover_key explains every step on std::cout - not part of the timing
+            std::streambuf* console = std::cout.rdbuf(nullptr);
+            for (int i = 0; i < iterations; i++) sink = recover_key(text, key_length)[0];
+            std::cout.rdbuf(console);
+            std::cout.clear();
+        }},
+        {"break_caesar_shift", GB, [](Inputs& in, int iterations) {
+            const std::string& column = in.caesar();
+            for (int i = 0; i < iterations; i++) sink = break_caesar_shift(column);
+        }},
+    };
+}
+
+
+// One measurement, printed as a JSON line
+
+struct Result {
+    const char* name;
+    size_t bytes;
+    int iterations;
+    double seconds;
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    long peak_rss_kb;
+};
+
+
+const char* isa_name() {
+    switch (detect_shift_isa()) {
+        case ShiftIsa::AVX2:  return "avx2";
+        case ShiftIsa::SSE42: return "sse4.2";
+        case ShiftIsa::NEON:  return "neon";
+        default:              return "scalar";
+    }
+}
+
+
+void print_result_json(const Result& result) {
+    double total_bytes = static_cast<double>(result.bytes) * result.iterations;
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3)
+         << "{\"benchmark\":\"" << result.name << "\""
+         << ",\"bytes\":" << result.bytes
+         << ",\"iterations\":" << result.iterations
+         << ",\"seconds\":" << std::setprecision(6) << result.seconds
+         << ",\"mb_per_s\":" << std::setprecision(3) << total_bytes / 1e6 / result.seconds
+         << ",\"ns_per_byte\":" << std::setprecision(4) << result.seconds * 1e9 / total_bytes
+         << ",\"allocations\":" << std::setprecision(1)
+         << static_cast<double>(result.allocations) / result.iterations
+         << ",\"allocated_bytes\":"
+         << static_cast<double>(result.allocated_bytes) / result.iterations
+         << ",\"peak_rss_kb\":" << result.peak_rss_kb
+         << ",\"isa\":\"" << isa_name() << "\"}";
+    std::cout << line.str() << std::endl;
+}
+
+
+// Times one benchmark on one size
+// Doubles the iteration count until a batch takes at least min_time, so
+// small inputs get timed over many calls and 1 GB inputs over one
+
+Result measure(Benchmark& benchmark, Inputs& inputs, double min_time) {
+    using Clock = std::chrono::steady_clock;
+
+    benchmark.run(inputs, 0);  // Generate inputs outside the timing
+    benchmark.run(inputs, 1);  // Warm-up: page in, fill caches
+
+    Result result{benchmark.name, inputs.size, 0, 0.0, 0, 0, 0};
+    for (int iterations = 1;; iterations *= 2) {
+        reset_peak_rss();
+        uint64_t allocations_before = allocation_count.load();
+        uint64_t bytes_before = allocated_bytes.load();
+
+        Clock::time_point start = Clock::now();
+        benchmark.run(inputs, iterations);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        result.iterations = iterations;
+        result.seconds = seconds;
+        result.allocations = allocation_count.load() - allocations_before;
+        result.allocated_bytes = allocated_bytes.load() - bytes_before;
+        result.peak_rss_kb = peak_rss_kb();
+
+        if (seconds >= min_time || iterations >= (1 << 24)) return result;
+    }
+}
+
+
+// ============================================================================
+// MAIN PROGRAM
+// ============================================================================
+
+// parse_size (65536, 64K, 1M, 2G) comes from cipher.h
+
+
+// Command-line flags
+struct Options {
+    size_t min_size = size_t(1) << 10;   // --min-size SIZE
+    size_t max_size = size_t(64) << 20;  // --max-size SIZE (up to 1G)
+    double min_time = 0.2;               // --min-time SECONDS per measurement
+    std::vector<std::string> only;       // --only NAME,NAME: just these benchmarks
+};
+
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--min-size SIZE] [--max-size SIZE]"
+              << " [--min-time SECONDS] [--only NAME,NAME...]\n"
+              << "       (SIZE like 1K, 64M, 1G; sizes go up by 4x from min to max)" << std::endl;
+}
+
+
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--min-size" && has_value) {
+            options.min_size = parse_size(arg, argv[++i]);
+        } else if (arg == "--max-size" && has_value) {
+            options.max_size = parse_size(arg, argv[++i]);
+        } else if (arg == "--min-time" && has_value) {
+            options.min_time = std::atof(argv[++i]);
+            if (options.min_time <= 0.0 || options.min_time > 3600.0) {
+                std::cerr << "Error: --min-time must be between 0 and 3600 seconds" << std::endl;
+                exit(1);
+            }
+        } else if (arg == "--only" && has_value) {
+            std::stringstream names(argv[++i]);
+            std::string name;
+            while (std::getline(names, name, ',')) options.only.push_back(name);
+        } else {
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if (options.min_size > options.max_size) {
+        std::cerr << "Error: --min-size is larger than --max-size" << std::endl;
+        exit(1);
+    }
+    return options;
+}
+
+
+int main(int argc, char* argv[]) {
+    Options options = parse_options(argc, argv);
+    std::vector<Benchmark> benchmarks = make_benchmarks();
+
+    for (const std::string& name : options.only) {
+        bool known = std::any_of(benchmarks.begin(), benchmarks.end(),
+                                 [&](const Benchmark& b) { return name == b.name; });
+        if (!known) {
+            std::cerr << "Error: unknown benchmark " << name << " (known:";
+            for (const Benchmark& b : benchmarks) std::cerr << ' ' << b.name;
+            std::cerr << ")" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!reset_peak_rss()) {
+        std::cerr << "Warning: can't reset peak memory, peak_rss_kb only ever grows" << std::endl;
+    }
+
+    for (size_t size = options.min_size; size <= options.max_size; size *= 4) {
+        Inputs inputs{size, "", "", ""};
+
+        for (Benchmark& benchmark : benchmarks) {
+            bool selected = options.only.empty() ||
+                            std::find(options.only.begin(), options.only.end(), benchmark.name) !=
+                                options.only.end();
+            if (!selected || size > benchmark.max_bytes) continue;
+
+            print_result_json(measure(benchmark, inputs, options.min_time));
+        }
+    }
+
+    return 0;
+}
@@ -1,77 +1,146 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
-#include <cctype>
-
-std::string caesar_encrypt(const std::string& text, int shift) {
-    std::string result = text;
-    
-    for (char& c : result) {
-        if (std::isalpha(c)) {
-            c = std::toupper(c);
-            int pos = c - 'A';
-            pos = (pos + shift + 26) % 26;
-            c = pos + 'A';
-        }
+#include <string_view>
+#include <vector>
+#include "cipher.h"
+#include "cipher_io.h"
+#include "shift_score.h"
+
+// The cipher itself (caesar_encrypt, transform) and the file handling
+// (stream_file, mmap_file, transform_in_place) live in cipher.h, shared
+// with vigenere.cpp. Caesar is a Vigenère key of length 1: one shift for
+// every letter, so blocks of a file are independent of each other.
+
+
+// Bytes counted per sample block in crack mode with --sample
+const size_t SAMPLE_BLOCK = 64 * 1024;
+
+
+// A-Z histogram of a file for crack mode
+// With sample = 0 every byte is counted. Otherwise about `sample` bytes
+// are, in SAMPLE_BLOCK pieces spread evenly from start to end - so only
+// those pages of the mapped file are ever read, and a file that starts
+// with a header or a table still gets a fair sample of its text. A sample
+// is never less than one whole block: a few bytes can't say much about
+// letter frequencies, and may well hold no letters at all.
+// Returns how many bytes were counted
+
+size_t sample_letter_counts(std::string_view data, size_t sample, uint64_t counts[26],
+                            TaskPool* pool) {
+    if (sample == 0 || sample >= data.size()) {
+        count_letters_parallel(data, counts, pool);
+        return data.size();
     }
-    
-    return result;
-}
 
-std::string read_file(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
-        exit(1);
+    size_t blocks = std::max<size_t>(1, sample / SAMPLE_BLOCK);
+    size_t stride = data.size() / blocks;
+
+    std::fill(counts, counts + 26, 0);
+    size_t counted = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        std::string_view piece = data.substr(b * stride, SAMPLE_BLOCK);
+        uint64_t piece_counts[26];
+        count_letters(piece, piece_counts);
+        for (int i = 0; i < 26; i++) counts[i] += piece_counts[i];
+        counted += piece.size();
     }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();  // Read entire file into buffer
-    return buffer.str();
+    return counted;
 }
 
-void write_file(const std::string& filename, const std::string& content) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not write to file " << filename << std::endl;
+
+// crack: finds the shift from one histogram instead of trying all 26
+// Decrypting with shift s just rotates the histogram by s, so best_shift
+// (shift_score.h) scores the 26 rotations against English without touching
+// the text again. Then the file goes through the cipher once, as usual.
+// Returns the shift that decrypts the file
+
+// A compressed file can't be sampled without decompressing all of it, so
+// it is counted whole, a block at a time while the next is decompressed
+
+int crack_shift(const std::string& filename, size_t sample, unsigned threads) {
+    uint64_t counts[26];
+    size_t counted, size;
+    if (file_compression(filename) != Compression::NONE) {
+        counted = size = count_file_letters(filename, counts, threads);
+    } else {
+        MappedInput input(filename);
+        TaskPool pool(threads - 1);  // The calling thread helps out
+        counted = sample_letter_counts(input.view(), sample, counts, &pool);
+        size = input.size();
+    }
+
+    uint64_t letters = 0;
+    for (int i = 0; i < 26; i++) letters += counts[i];
+    if (letters == 0) {
+        std::cerr << "Error: " << filename << " has no letters to crack" << std::endl;
         exit(1);
     }
-    
-    file << content;
+
+    int shift = best_shift(counts);
+    std::cout << "Counted " << letters << " letters in " << counted << " of " << size
+              << " bytes" << (counted < size ? " (sampled)" : "") << std::endl;
+    std::cout << "Most likely shift: " << shift << " (decrypting with " << -shift << ")"
+              << std::endl;
+    return -shift;
 }
 
+
 int main(int argc, char* argv[]) {
     // Check argument count
     if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <filename> <shift>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <filename> <shift> [--threads N] [--mmap] [--in-place] [--compress gzip|zstd]\n"
+                  << "       " << argv[0] << " <filename> crack [--sample SIZE] [--threads N] [--mmap] [--in-place] [--compress gzip|zstd]"
+                  << std::endl;
         return 1;
     }
-    
-    // Parse and validate shift
-    int shift;
-    try {
-        shift = std::stoi(argv[2]);
-        if (shift < -25 || shift > 25) {
-            std::cerr << "Error: shift must be between -25 and 25" << std::endl;
+
+    // Parse and validate shift, or crack mode
+    bool crack = std::string(argv[2]) == "crack";
+    int shift = 0;
+    if (!crack) {
+        try {
+            shift = std::stoi(argv[2]);
+            if (shift < -25 || shift > 25) {
+                std::cerr << "Error: shift must be between -25 and 25" << std::endl;
+                return 1;
+            }
+        } catch (...) {
+            std::cerr << "Error: shift must be a valid integer or 'crack'" << std::endl;
             return 1;
         }
-    } catch (...) {
-        std::cerr << "Error: shift must be a valid integer" << std::endl;
-        return 1;
     }
-    
+
+    // Optional flags after the shift; --sample is crack mode's own
+    std::vector<char*> args(argv, argv + 3);
+    size_t sample = 0;
+    for (int i = 3; i < argc; i++) {
+        if (crack && std::string(argv[i]) == "--sample" && i + 1 < argc) {
+            sample = parse_size("--sample", argv[++i]);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    FileOptions options = parse_file_options(static_cast<int>(args.size()), args.data(), 3);
+
     // Get filenames
     std::string input_filename = argv[1];
-    std::string output_filename = "shifted_" + input_filename;
-    
+    std::string output_filename = output_file_name(input_filename, "shifted_", options);
+
+    if (crack) shift = crack_shift(input_filename, sample, options.threads);
+
     // Read, process, and write
-    std::string content = read_file(input_filename);
-    std::string processed = caesar_encrypt(content, shift);
-    write_file(output_filename, processed);
-    
+    ShiftSchedule schedule = make_schedule(shift);
+
+    if (options.in_place) {
+        transform_in_place(input_filename, schedule, options.threads);
+    } else if (options.use_mmap) {
+        mmap_file(input_filename, output_filename, schedule, options.threads);
+    } else {
+        stream_file(input_filename, output_filename, schedule, options.threads);
+    }
+
     std::cout << "Processed " << input_filename << " with shift " << shift << std::endl;
     std::cout << "Output written to " << output_filename << std::endl;
-    
+
     return 0;
 }
@@ -0,0 +1,717 @@
+// ============================================================================
+// LIBCIPHER - The shared cipher library behind all four tools
+// ============================================================================
+// Everything the tools have in common, in one header:
+//
+//   transform      - Caesar/Vigenère on a buffer, in place or into an
+//                    output buffer (the SIMD kernels in shift_kernel.h)
+//   count_letters  - A-Z histogram of a buffer (count_letters_parallel
+//                    splits it across threads)
+//   clean_letters  - copy just the letters, uppercased
+//   variants       - Beaufort, variant Beaufort, autokey and running key
+//                    on the same schedules and tables
+//   stream_file, mmap_file, transform_in_place
+//                  - the three ways the CLIs push a file through a cipher
+//                    (gzip/zstd files go through stream_blocks instead)
+//
+// The buffer functions take std::span and never allocate, so a program
+// linking this header can reuse its own buffers from call to call. The
+// std::string versions below them are conveniences built on top.
+//
+// Header-only like the rest of the shared code: just #include "cipher.h"
+// and link the CMake target `cipher`, which sets -std=c++20 (for
+// std::span) and -pthread.
+// ============================================================================
+
+#ifndef CIPHER_H
+#define CIPHER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cipher_io.h"
+#include "shift_kernel.h"
+#include "task_pool.h"
+
+
+// Size of each block in streaming mode (1 MiB)
+// Only one block is held in memory at a time, so memory use stays
+// the same no matter how large the input file is
+const size_t CHUNK_SIZE = 1 << 20;
+
+// How much transform() copies before shifting it, so the copy is still
+// in L1/L2 cache when the kernel reads it back
+const size_t COPY_BLOCK = 64 * 1024;
+
+
+// ============================================================================
+// BUFFERS - Allocation-free span API
+// ============================================================================
+
+// Shifts every letter of a buffer in place
+// key_pos: the key phase (0..period-1) carried between calls - the phase
+//          the buffer starts at, and on return the one after it
+// Non-letters are left unchanged, letters come out uppercase
+// With a pool, the buffer is split across its workers and the caller
+
+inline void transform(std::span<char> data, const ShiftSchedule& schedule, size_t& key_pos,
+                      TaskPool* pool = nullptr) {
+    apply_schedule_parallel(data.data(), data.size(), schedule, key_pos, pool);
+}
+
+
+// Writes the transformed input into out, leaving the input alone
+// Processes min(in.size(), out.size()) bytes and returns that count
+
+inline size_t transform(std::span<const char> in, std::span<char> out,
+                        const ShiftSchedule& schedule, size_t& key_pos, TaskPool* pool = nullptr) {
+    size_t length = std::min(in.size(), out.size());
+
+    if (pool != nullptr && pool->size() > 0) {
+        std::memcpy(out.data(), in.data(), length);
+        apply_schedule_parallel(out.data(), length, schedule, key_pos, pool);
+        return length;
+    }
+
+    for (size_t offset = 0; offset < length; offset += COPY_BLOCK) {
+        size_t block = std::min(COPY_BLOCK, length - offset);
+        std::memcpy(out.data() + offset, in.data() + offset, block);
+        apply_schedule(out.data() + offset, block, schedule, key_pos);
+    }
+    return length;
+}
+
+
+// Letter index of every byte: 0-25 for A-Z and a-z, 26 for everything else
+// Same letter test as the kernels, so non-ASCII bytes never count
+
+struct LetterBins {
+    uint8_t bin[256];
+};
+
+constexpr LetterBins make_letter_bins() {
+    LetterBins bins{};
+    for (int c = 0; c < 256; c++) {
+        uint8_t pos = static_cast<uint8_t>((c | 0x20) - 'a');
+        bins.bin[c] = pos < 26 ? pos : 26;
+    }
+    return bins;
+}
+
+inline constexpr LetterBins LETTER_BINS = make_letter_bins();
+
+
+// Counts letters A-Z (either case) in a buffer
+//
+// One histogram updated byte after byte is slow: when the same letter
+// comes twice in a row, the second increment has to wait for the first
+// one's store to land (a store-to-load stall). So four sub-histograms
+// take turns - byte i goes to histogram i % 4, and repeated letters hit
+// different memory. Non-letters all go to a 27th bin instead of a branch.
+//
+// The sub-histograms use 32-bit counters (half the cache footprint) and
+// are added into the 64-bit totals every COUNT_FLUSH bytes, long before
+// they could overflow.
+
+const size_t COUNT_FLUSH = size_t(1) << 30;
+
+inline void count_letters(std::span<const char> text, uint64_t counts[26]) {
+    std::fill(counts, counts + 26, 0);
+
+    const uint8_t* bin = LETTER_BINS.bin;
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+    size_t length = text.size();
+
+    for (size_t start = 0; start < length; start += COUNT_FLUSH) {
+        size_t end = std::min(length, start + COUNT_FLUSH);
+        uint32_t sub[4][32] = {};
+
+        size_t i = start;
+        for (; i + 8 <= end; i += 8) {
+            sub[0][bin[data[i]]]++;
+            sub[1][bin[data[i + 1]]]++;
+            sub[2][bin[data[i + 2]]]++;
+            sub[3][bin[data[i + 3]]]++;
+            sub[0][bin[data[i + 4]]]++;
+            sub[1][bin[data[i + 5]]]++;
+            sub[2][bin[data[i + 6]]]++;
+            sub[3][bin[data[i + 7]]]++;
+        }
+        for (; i < end; i++) sub[0][bin[data[i]]]++;
+
+        for (int letter = 0; letter < 26; letter++) {
+            counts[letter] += uint64_t(sub[0][letter]) + sub[1][letter] +
+                              sub[2][letter] + sub[3][letter];
+        }
+    }
+}
+
+
+// count_letters on the pool's workers plus the calling thread, one slice
+// each (nullptr = the calling thread alone). Slices of a memory-mapped
+// file are paged in by their own thread, so with enough threads the disk
+// becomes the limit. The pool is the caller's, so counting block after
+// block doesn't start new threads for each one
+
+inline void count_letters_parallel(std::span<const char> text, uint64_t counts[26],
+                                   TaskPool* pool) {
+    const size_t MIN_SLICE = 1 << 20;
+
+    size_t threads = pool != nullptr ? pool->size() + 1 : 1;
+    threads = std::min(threads, text.size() / MIN_SLICE);
+    if (threads <= 1 || pool == nullptr) {
+        count_letters(text, counts);
+        return;
+    }
+
+    size_t slice = (text.size() + threads - 1) / threads;
+    std::vector<uint64_t> partial(threads * 26);
+
+    pool->parallel_for(threads, [&](size_t k) {
+        size_t begin = std::min(text.size(), k * slice);
+        size_t length = std::min(slice, text.size() - begin);
+        count_letters(text.subspan(begin, length), partial.data() + k * 26);
+    });
+
+    std::fill(counts, counts + 26, 0);
+    for (size_t k = 0; k < threads; k++) {
+        for (int letter = 0; letter < 26; letter++) counts[letter] += partial[k * 26 + letter];
+    }
+}
+
+
+// Copies just the letters of in to out, uppercased
+// Writes at most out.size() letters; returns how many were written
+
+inline size_t clean_letters(std::span<const char> in, std::span<char> out) {
+    size_t written = 0;
+
+    for (size_t i = 0; i < in.size() && written < out.size(); i++) {
+        uint8_t pos = static_cast<uint8_t>((in[i] | 0x20) - 'a');
+        if (pos < 26) out[written++] = static_cast<char>('A' + pos);
+    }
+    return written;
+}
+
+
+// ============================================================================
+// STRINGS - Conveniences that allocate the result
+// ============================================================================
+
+inline std::string caesar_encrypt(const std::string& text, int shift) {
+    std::string result = text;
+    size_t key_pos = 0;
+    transform(result, make_schedule(shift), key_pos);
+    return result;
+}
+
+
+// direction: +1 for encryption, -1 for decryption
+inline std::string vigenere_process(const std::string& text, const std::string& key,
+                                    int direction) {
+    std::string result = text;
+    size_t key_pos = 0;
+    transform(result, make_schedule(key, direction), key_pos);
+    return result;
+}
+
+inline std::string vigenere_encrypt(const std::string& text, const std::string& key) {
+    return vigenere_process(text, key, 1);
+}
+
+inline std::string vigenere_decrypt(const std::string& text, const std::string& key) {
+    return vigenere_process(text, key, -1);
+}
+
+
+// ============================================================================
+// VARIANTS - The Vigenère family on the same kernels
+// ============================================================================
+// With p the plaintext letter, c the ciphertext letter and k the key
+// letter (all 0-25, mod 26):
+//
+//   Vigenère          c = p + k        p = c - k
+//   Beaufort          c = k - p        p = k - c   (its own inverse)
+//   variant Beaufort  c = p - k        p = c + k   (Vigenère backwards)
+//   running key       Vigenère with a key as long as the text - a
+//                     passage of a book instead of a keyword
+//   autokey           the primer, then the plaintext itself is the key:
+//                     k[i] = p[i - primer length]
+//
+// All but autokey are a ShiftSchedule: Beaufort is k - p = k + (-p), a
+// Vigenère shift of the negated letters (schedule.reflect), and variant
+// Beaufort is Vigenère in the other direction. So they run through the
+// same kernels, threads and file modes as Vigenère itself.
+//
+// Autokey can't be: every key letter is a plaintext letter, known only
+// once the letters before it are done. It gets a table-driven loop of
+// its own that carries its state from one block to the next.
+
+enum class CipherVariant { VIGENERE, BEAUFORT, VARIANT_BEAUFORT, AUTOKEY, RUNNING_KEY };
+
+const CipherVariant ALL_VARIANTS[] = {CipherVariant::VIGENERE, CipherVariant::BEAUFORT,
+                                      CipherVariant::VARIANT_BEAUFORT, CipherVariant::AUTOKEY,
+                                      CipherVariant::RUNNING_KEY};
+
+inline const char* variant_name(CipherVariant variant) {
+    switch (variant) {
+        case CipherVariant::VIGENERE:         return "vigenere";
+        case CipherVariant::BEAUFORT:         return "beaufort";
+        case CipherVariant::VARIANT_BEAUFORT: return "variant-beaufort";
+        case CipherVariant::AUTOKEY:          return "autokey";
+        case CipherVariant::RUNNING_KEY:      return "running-key";
+        default:                              return "?";
+    }
+}
+
+
+// Looks a variant up by its name; returns false if there is none
+
+inline bool parse_variant(const std::string& name, CipherVariant& variant) {
+    for (CipherVariant candidate : ALL_VARIANTS) {
+        if (name == variant_name(candidate)) {
+            variant = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Schedule for every variant except autokey
+// direction: +1 for encryption, -1 for decryption
+
+inline ShiftSchedule make_variant_schedule(CipherVariant variant, const std::string& key,
+                                           int direction) {
+    switch (variant) {
+        case CipherVariant::BEAUFORT: {
+            ShiftSchedule schedule = make_schedule(key, 1);
+            schedule.reflect = true;
+            return schedule;
+        }
+        case CipherVariant::VARIANT_BEAUFORT:
+            return make_schedule(key, -direction);
+        default:
+            return make_schedule(key, direction);
+    }
+}
+
+
+// Where an autokey transform is: the key letters of the next
+// primer-length letters, as a ring. Carried from block to block like
+// key_pos, so a file can be done in pieces
+
+struct AutokeyState {
+    std::vector<uint8_t> ring;  // Shifts (0-25) of the next ring.size() letters
+    size_t next = 0;            // Ring slot of the next letter
+    int direction = 1;
+};
+
+inline AutokeyState make_autokey(const std::string& primer, int direction) {
+    AutokeyState state;
+    for (char c : primer) {
+        state.ring.push_back(static_cast<uint8_t>(std::toupper(static_cast<unsigned char>(c)) - 'A'));
+    }
+    if (state.ring.empty()) state.ring.push_back(0);
+    state.direction = direction;
+    return state;
+}
+
+
+// Autokey on a buffer in place - the letters come out uppercase, the
+// rest is left unchanged and does not use up a key letter
+// Each letter is one lookup in the same tables as the Vigenère kernels;
+// the plaintext letter (the output when decrypting, the input when
+// encrypting) goes into the ring as the key for primer-length letters on
+
+inline void autokey_transform(std::span<char> data, AutokeyState& state) {
+    const uint8_t* bin = LETTER_BINS.bin;
+    uint8_t* ring = state.ring.data();
+    size_t length = state.ring.size();
+    size_t next = state.next;
+    bool encrypt = state.direction > 0;
+
+    for (char& byte : data) {
+        uint8_t c = static_cast<uint8_t>(byte);
+        uint8_t pos = bin[c];
+        if (pos == 26) continue;
+
+        uint8_t shift = encrypt ? ring[next] : static_cast<uint8_t>((26 - ring[next]) % 26);
+        uint8_t out = TRANSLATION_TABLES.translate[shift][c];
+        ring[next] = encrypt ? pos : static_cast<uint8_t>(out - 'A');
+        byte = static_cast<char>(out);
+        if (++next == length) next = 0;
+    }
+
+    state.next = next;
+}
+
+
+// Any variant on a whole string
+// direction: +1 for encryption, -1 for decryption
+
+inline std::string variant_process(const std::string& text, const std::string& key,
+                                   CipherVariant variant, int direction) {
+    std::string result = text;
+    if (variant == CipherVariant::AUTOKEY) {
+        AutokeyState state = make_autokey(key, direction);
+        autokey_transform(result, state);
+    } else {
+        size_t key_pos = 0;
+        transform(result, make_variant_schedule(variant, key, direction), key_pos);
+    }
+    return result;
+}
+
+inline std::string variant_encrypt(const std::string& text, const std::string& key,
+                                   CipherVariant variant) {
+    return variant_process(text, key, variant, 1);
+}
+
+inline std::string variant_decrypt(const std::string& text, const std::string& key,
+                                   CipherVariant variant) {
+    return variant_process(text, key, variant, -1);
+}
+
+
+// ============================================================================
+// FILES - What the command-line tools do
+// ============================================================================
+
+// Command-line flags of caesar and vigenere, after the required arguments
+
+struct FileOptions {
+    unsigned threads = 1;   // --threads N
+    bool use_mmap = false;  // --mmap: map input and output instead of streaming
+    bool in_place = false;  // --in-place: overwrite the input file
+    Compression compress = Compression::NONE;  // --compress gzip|zstd: compress the output
+};
+
+
+// Parses the integer value of a flag (--threads, --max-key, ...) and
+// checks its range
+// The whole value must be the number: "8x" or "1.5" is an error, not 8 or 1
+
+inline int parse_int_flag(const std::string& flag, const char* value, int min, int max) {
+    int result = min - 1;
+    try {
+        size_t used = 0;
+        int parsed = std::stoi(value, &used);
+        if (used == std::strlen(value)) result = parsed;
+    } catch (...) {
+    }
+
+    if (result < min || result > max) {
+        std::cerr << "Error: " << flag << " must be between " << min << " and " << max << std::endl;
+        exit(1);
+    }
+    return result;
+}
+
+
+// Parses the optional flags from argv[first] onwards
+
+inline FileOptions parse_file_options(int argc, char* argv[], int first) {
+    FileOptions options;
+
+    for (int i = first; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.threads = parse_int_flag(arg, argv[++i], 1, 1024);
+        } else if (arg == "--mmap") {
+            options.use_mmap = true;
+        } else if (arg == "--in-place") {
+            options.in_place = true;
+        } else if (arg == "--compress" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "gzip") {
+                options.compress = Compression::GZIP;
+            } else if (name == "zstd") {
+                options.compress = Compression::ZSTD;
+            } else {
+                std::cerr << "Error: --compress must be 'gzip' or 'zstd'" << std::endl;
+                exit(1);
+            }
+            require_compression(options.compress, "--compress " + name);
+        } else {
+            std::cerr << "Error: unknown option " << arg << std::endl;
+            exit(1);
+        }
+    }
+
+    if (options.in_place && options.compress != Compression::NONE) {
+        std::cerr << "Error: --in-place and --compress can't be used together" << std::endl;
+        exit(1);
+    }
+
+    return options;
+}
+
+
+// Parses a size like 65536, 64K, 1M or 2G (--window, --sample, ...)
+
+inline size_t parse_size(const std::string& flag, const std::string& value) {
+    size_t multiplier = 1;
+    std::string digits = value;
+    if (!digits.empty()) {
+        char suffix = std::toupper(static_cast<unsigned char>(digits.back()));
+        if (suffix == 'K') multiplier = size_t(1) << 10;
+        if (suffix == 'M') multiplier = size_t(1) << 20;
+        if (suffix == 'G') multiplier = size_t(1) << 30;
+        if (multiplier > 1) digits.pop_back();
+    }
+
+    try {
+        size_t used = 0;
+        unsigned long long n = std::stoull(digits, &used);
+        // 99999999999G would wrap around to a small size
+        if (used == digits.size() && n > 0 && n <= SIZE_MAX / multiplier) return n * multiplier;
+    } catch (...) {
+    }
+
+    std::cerr << "Error: " << flag << " must be a positive size (e.g. 65536, 64K, 1M)" << std::endl;
+    exit(1);
+}
+
+
+// Name of the file a tool writes: prefix + input name, or the input
+// itself with --in-place. --compress adds .gz or .zst if it isn't there
+// already - written files are compressed by the end of their name
+
+inline std::string output_file_name(const std::string& input_filename, const std::string& prefix,
+                                    const FileOptions& options) {
+    if (options.in_place) return input_filename;
+
+    std::string name = prefix + input_filename;
+    if (options.compress != Compression::NONE && compression_for_name(name) != options.compress) {
+        name += options.compress == Compression::GZIP ? ".gz" : ".zst";
+    }
+    return name;
+}
+
+
+// Whether a file operation has to go through stream_blocks: a gzip or
+// zstd input, or an output name ending in .gz or .zst
+
+inline bool compressed_files(const std::string& input_filename,
+                             const std::string& output_filename) {
+    return file_compression(input_filename) != Compression::NONE ||
+           compression_for_name(output_filename) != Compression::NONE;
+}
+
+
+// Compressed input can only be rewritten into a new file
+
+inline void check_in_place(const std::string& filename) {
+    Compression compression = file_compression(filename);
+    if (compression != Compression::NONE) {
+        std::cerr << "Error: " << filename << " is " << compression_name(compression)
+                  << "-compressed and can't be transformed in place" << std::endl;
+        exit(1);
+    }
+}
+
+
+// Pushes a file through transform_block(std::span<char>) one block at a
+// time, for compressed files: the input is decompressed a block ahead on
+// the BlockReader's thread, and the output is compressed if its name
+// says so. Plain input works too - it is then only copied ahead
+
+template <typename BlockTransform>
+inline void stream_blocks(const std::string& input_filename, const std::string& output_filename,
+                          size_t block_size, BlockTransform transform_block) {
+    BlockReader reader(input_filename, block_size);
+    CompressedOutput out(output_filename, compression_for_name(output_filename));
+
+    for (std::span<char> block = reader.next(); !block.empty(); block = reader.next()) {
+        transform_block(block);
+        out.write(block);
+    }
+    out.finish();
+}
+
+
+// A-Z counts of a file read through a BlockReader: each block is counted
+// while the next one is decompressed. Returns the bytes read
+
+inline uint64_t count_file_letters(const std::string& filename, uint64_t counts[26],
+                                   unsigned threads) {
+    BlockReader reader(filename, CHUNK_SIZE * threads);
+    TaskPool pool(threads - 1);
+    std::fill(counts, counts + 26, 0);
+    uint64_t bytes = 0;
+
+    for (std::span<char> block = reader.next(); !block.empty(); block = reader.next()) {
+        uint64_t block_counts[26];
+        count_letters_parallel(block, block_counts, &pool);
+        for (int i = 0; i < 26; i++) counts[i] += block_counts[i];
+        bytes += block.size();
+    }
+    return bytes;
+}
+
+
+// Streams a file through the cipher one block at a time:
+// read a block, transform it, write it, repeat
+// key_pos lives outside the loop so the key keeps going where the
+// previous block stopped - the output is identical to processing
+// the whole file at once
+// The threads are started once, here, and every block reuses them
+
+inline void stream_file(const std::string& input_filename, const std::string& output_filename,
+                        const ShiftSchedule& schedule, unsigned threads) {
+    TaskPool pool(threads - 1);  // The calling thread helps out
+    size_t key_pos = 0;
+    if (compressed_files(input_filename, output_filename)) {
+        stream_blocks(input_filename, output_filename, CHUNK_SIZE * threads,
+                      [&](std::span<char> block) { transform(block, schedule, key_pos, &pool); });
+        return;
+    }
+
+    std::ifstream in(input_filename, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open file " << input_filename << std::endl;
+        exit(1);
+    }
+
+    std::ofstream out(output_filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not write to file " << output_filename << std::endl;
+        exit(1);
+    }
+
+    // With several threads, read one block per thread at a time
+    std::vector<char> buffer(CHUNK_SIZE * threads);
+
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        std::streamsize got = in.gcount();
+        if (got <= 0) break;
+
+        transform(std::span<char>(buffer.data(), got), schedule, key_pos, &pool);
+        out.write(buffer.data(), got);
+    }
+
+    if (in.bad()) {
+        std::cerr << "Error: Could not read file " << input_filename << std::endl;
+        exit(1);
+    }
+    if (!out) {
+        std::cerr << "Error: Could not write to file " << output_filename << std::endl;
+        exit(1);
+    }
+}
+
+
+// Memory-mapped version of stream_file
+// The input is mapped read-only and the output file is created at its
+// final size and mapped writable. Each block is copied from one mapping
+// to the other and shifted there while it is still in cache - no
+// read buffers, no extra copies of the whole file
+// Compressed files can't be mapped usefully, so they are streamed
+
+inline void mmap_file(const std::string& input_filename, const std::string& output_filename,
+                      const ShiftSchedule& schedule, unsigned threads) {
+    if (compressed_files(input_filename, output_filename)) {
+        stream_file(input_filename, output_filename, schedule, threads);
+        return;
+    }
+
+    MappedInput input(input_filename);
+    WritableMap output(output_filename, input.size());
+    TaskPool pool(threads - 1);
+
+    size_t block = CHUNK_SIZE * threads;
+    size_t key_pos = 0;
+
+    for (size_t offset = 0; offset < input.size(); offset += block) {
+        size_t length = std::min(block, input.size() - offset);
+        transform(std::span<const char>(input.data() + offset, length),
+                  std::span<char>(output.data() + offset, length), schedule, key_pos, &pool);
+    }
+}
+
+
+// Transforms a file where it is: the file is mapped writable and every
+// block is overwritten with its shifted version
+
+inline void transform_in_place(const std::string& filename, const ShiftSchedule& schedule,
+                               unsigned threads) {
+    check_in_place(filename);
+    WritableMap file(filename);
+    TaskPool pool(threads - 1);
+    size_t key_pos = 0;
+    transform(std::span<char>(file.data(), file.size()), schedule, key_pos, &pool);
+}
+
+
+// Autokey version of the three file functions above, picked by options
+// There is no --threads: every key letter depends on the text before it
+
+inline void autokey_file(const std::string& input_filename, const std::string& output_filename,
+                         AutokeyState state, const FileOptions& options) {
+    if (options.in_place) {
+        check_in_place(input_filename);
+        WritableMap file(input_filename);
+        autokey_transform(std::span<char>(file.data(), file.size()), state);
+        return;
+    }
+
+    if (compressed_files(input_filename, output_filename)) {
+        stream_blocks(input_filename, output_filename, CHUNK_SIZE,
+                      [&](std::span<char> block) { autokey_transform(block, state); });
+        return;
+    }
+
+    if (options.use_mmap) {
+        MappedInput input(input_filename);
+        WritableMap output(output_filename, input.size());
+        for (size_t offset = 0; offset < input.size(); offset += COPY_BLOCK) {
+            size_t length = std::min(COPY_BLOCK, input.size() - offset);
+            std::memcpy(output.data() + offset, input.data() + offset, length);
+            autokey_transform(std::span<char>(output.data() + offset, length), state);
+        }
+        return;
+    }
+
+    std::ifstream in(input_filename, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open file " << input_filename << std::endl;
+        exit(1);
+    }
+
+    std::ofstream out(output_filename, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not write to file " << output_filename << std::endl;
+        exit(1);
+    }
+
+    std::vector<char> buffer(CHUNK_SIZE);
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        std::streamsize got = in.gcount();
+        if (got <= 0) break;
+
+        autokey_transform(std::span<char>(buffer.data(), got), state);
+        out.write(buffer.data(), got);
+    }
+
+    if (in.bad()) {
+        std::cerr << "Error: Could not read file " << input_filename << std::endl;
+        exit(1);
+    }
+    if (!out) {
+        std::cerr << "Error: Could not write to file " << output_filename << std::endl;
+        exit(1);
+    }
+}
+
+#endif  // CIPHER_H
@@ -0,0 +1,724 @@
+// ============================================================================
+// CIPHER I/O - Shared memory-mapped file access for all four tools
+// ============================================================================
+// Reading a file through ifstream → stringstream → std::string copies the
+// whole file twice before any work starts. mmap instead asks the kernel to
+// make the file's pages appear directly in our address space: nothing is
+// copied, and pages are only loaded when they are first touched.
+//
+//   MappedInput  - read-only view of a file (or stdin, which can't be mapped)
+//   WritableMap  - writable mapping, either a new pre-sized output file or
+//                  an existing file to transform in place
+//   BlockReader, CompressedOutput
+//                - gzip/zstd input decompressed on its own thread, a block
+//                  at a time, and compressed output (see COMPRESSION below)
+//
+// Errors are reported the same way as the rest of the tools: a message on
+// std::cerr and exit(1).
+// ============================================================================
+
+#ifndef CIPHER_IO_H
+#define CIPHER_IO_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef CIPHER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+// Reads everything from a file descriptor into a string
+// Used for stdin and pipes, which can't be memory-mapped
+
+inline std::string read_all(int fd, const std::string& name) {
+    std::string result;
+    char buffer[1 << 16];
+
+    while (true) {
+        ssize_t got = ::read(fd, buffer, sizeof(buffer));
+        if (got == 0) break;
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: Could not read " << name << std::endl;
+            exit(1);
+        }
+        result.append(buffer, got);
+    }
+
+    return result;
+}
+
+
+// ============================================================================
+// COMPRESSION - gzip and zstd
+// ============================================================================
+// Ciphertext archives are often kept compressed. Every tool reads them
+// as they are, with no temp file in between. The compression is recognised
+// by the first bytes of the file, not by its name:
+//
+//   MappedInput      - a compressed file is decompressed into memory whole
+//                      (for the tools that need all of the text at once)
+//   BlockReader      - decompresses on a thread of its own, a block ahead:
+//                      block N+1 is decompressed while the caller encrypts
+//                      or counts block N
+//   CompressedOutput - writes plain, gzip or zstd
+//
+// gzip needs zlib:   configure with cmake -DCIPHER_HAVE_ZLIB=ON
+// zstd needs libzstd: configure with cmake -DCIPHER_HAVE_ZSTD=ON
+// A build without them still recognises compressed files, and says which
+// flag is missing instead of treating them as text.
+
+enum class Compression { NONE, GZIP, ZSTD };
+
+inline const char* compression_name(Compression compression) {
+    switch (compression) {
+        case Compression::GZIP: return "gzip";
+        case Compression::ZSTD: return "zstd";
+        default:                return "none";
+    }
+}
+
+
+// Compression of some bytes, from their magic number:
+// gzip starts with 1f 8b, a zstd frame with 28 b5 2f fd
+
+inline Compression detect_compression(std::string_view bytes) {
+    auto starts_with = [&](std::initializer_list<unsigned char> magic) {
+        if (bytes.size() < magic.size()) return false;
+        size_t i = 0;
+        for (unsigned char c : magic) {
+            if (static_cast<unsigned char>(bytes[i++]) != c) return false;
+        }
+        return true;
+    };
+    if (starts_with({0x1f, 0x8b})) return Compression::GZIP;
+    if (starts_with({0x28, 0xb5, 0x2f, 0xfd})) return Compression::ZSTD;
+    return Compression::NONE;
+}
+
+
+// Compression of a regular file, from its first bytes
+// Pipes and missing files count as uncompressed (reading would use them up)
+
+inline Compression file_compression(const std::string& filename) {
+    struct stat info;
+    if (::stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) return Compression::NONE;
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return Compression::NONE;
+    char magic[4];
+    ssize_t got = ::read(fd, magic, sizeof(magic));
+    ::close(fd);
+    return detect_compression(std::string_view(magic, got > 0 ? got : 0));
+}
+
+
+// Compression a file to write asks for by its name: .gz or .zst
+
+inline Compression compression_for_name(const std::string& filename) {
+    auto ends_with = [&](const std::string& suffix) {
+        return filename.size() > suffix.size() &&
+               filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (ends_with(".gz")) return Compression::GZIP;
+    if (ends_with(".zst")) return Compression::ZSTD;
+    return Compression::NONE;
+}
+
+
+// Stops with a message if this build can't read or write `compression`
+
+inline void require_compression(Compression compression, const std::string& name) {
+#ifndef CIPHER_HAVE_ZLIB
+    if (compression == Compression::GZIP) {
+        std::cerr << "Error: " << name << " needs gzip, which this build doesn't have"
+                  << " (configure with cmake -DCIPHER_HAVE_ZLIB=ON)" << std::endl;
+        exit(1);
+    }
+#endif
+#ifndef CIPHER_HAVE_ZSTD
+    if (compression == Compression::ZSTD) {
+        std::cerr << "Error: " << name << " needs zstd, which this build doesn't have"
+                  << " (configure with cmake -DCIPHER_HAVE_ZSTD=ON)" << std::endl;
+        exit(1);
+    }
+#endif
+    (void)compression;
+    (void)name;
+}
+
+
+// Decompresses bytes held in memory (usually a mapped file), as much at
+// a time as the caller asks for
+// Concatenated gzip members (cat a.gz b.gz) and zstd frames are read as
+// one stream, the way gzip -d and zstd -d read them
+
+class Decompressor {
+public:
+    Decompressor(std::string_view input, Compression compression)
+        : input_(input), compression_(compression) {
+#ifdef CIPHER_HAVE_ZLIB
+        if (compression_ == Compression::GZIP) {
+            // 15 + 32: the largest window, and expect a gzip (or zlib) header
+            if (inflateInit2(&gzip_, 15 + 32) != Z_OK) error_ = "could not start zlib";
+        }
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+        if (compression_ == Compression::ZSTD) {
+            zstd_ = ZSTD_createDStream();
+            if (zstd_ == nullptr) error_ = "could not start zstd";
+        }
+#endif
+        done_ = !error_.empty();
+    }
+
+    ~Decompressor() {
+#ifdef CIPHER_HAVE_ZLIB
+        if (compression_ == Compression::GZIP) inflateEnd(&gzip_);
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+        if (zstd_ != nullptr) ZSTD_freeDStream(zstd_);
+#endif
+    }
+
+    Decompressor(const Decompressor&) = delete;
+    Decompressor& operator=(const Decompressor&) = delete;
+
+    // Fills out with the next decompressed bytes and returns how many
+    // Less than out.size() only at the end - or on damaged input, which
+    // also sets error()
+    size_t read(std::span<char> out) {
+        if (done_ || out.empty()) return 0;
+
+        switch (compression_) {
+#ifdef CIPHER_HAVE_ZLIB
+            case Compression::GZIP: return read_gzip(out);
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+            case Compression::ZSTD: return read_zstd(out);
+#endif
+            case Compression::NONE: {
+                size_t length = std::min(out.size(), input_.size() - position_);
+                std::memcpy(out.data(), input_.data() + position_, length);
+                position_ += length;
+                done_ = position_ == input_.size();
+                return length;
+            }
+            default:
+                error_ = std::string("no ") + compression_name(compression_) + " support";
+                done_ = true;
+                return 0;
+        }
+    }
+
+    const std::string& error() const { return error_; }
+
+private:
+#ifdef CIPHER_HAVE_ZLIB
+    size_t read_gzip(std::span<char> out) {
+        // zlib counts in 32 bits: hand it at most 1 GiB of either side at once
+        const size_t PIECE = size_t(1) << 30;
+        size_t filled = 0;
+
+        while (filled < out.size()) {
+            if (gzip_.avail_in == 0 && position_ < input_.size()) {
+                size_t length = std::min(PIECE, input_.size() - position_);
+                gzip_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input_.data() + position_));
+                gzip_.avail_in = static_cast<uInt>(length);
+                position_ += length;
+            }
+
+            if (member_done_) {
+                if (gzip_.avail_in == 0) {
+                    done_ = true;
+                    break;
+                }
+                inflateReset(&gzip_);  // Another member follows
+                member_done_ = false;
+            }
+
+            size_t room = std::min(PIECE, out.size() - filled);
+            gzip_.next_out = reinterpret_cast<Bytef*>(out.data() + filled);
+            gzip_.avail_out = static_cast<uInt>(room);
+            int status = inflate(&gzip_, Z_NO_FLUSH);
+            filled += room - gzip_.avail_out;
+
+            if (status == Z_STREAM_END) {
+                member_done_ = true;
+            } else if (status == Z_BUF_ERROR && gzip_.avail_in == 0 && position_ == input_.size()) {
+                error_ = "the gzip stream is cut short";
+                done_ = true;
+                break;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                error_ = gzip_.msg != nullptr ? gzip_.msg : "damaged gzip data";
+                done_ = true;
+                break;
+            }
+        }
+        return filled;
+    }
+
+    z_stream gzip_ = {};
+    bool member_done_ = false;
+#endif
+
+#ifdef CIPHER_HAVE_ZSTD
+    size_t read_zstd(std::span<char> out) {
+        ZSTD_inBuffer in = {input_.data(), input_.size(), position_};
+        ZSTD_outBuffer output = {out.data(), out.size(), 0};
+
+        while (output.pos < output.size) {
+            size_t status = ZSTD_decompressStream(zstd_, &output, &in);
+            if (ZSTD_isError(status)) {
+                error_ = ZSTD_getErrorName(status);
+                done_ = true;
+                break;
+            }
+            if (in.pos == in.size && output.pos < output.size) {
+                // 0: the last frame is complete; anything else wants more input
+                if (status != 0) error_ = "the zstd stream is cut short";
+                done_ = true;
+                break;
+            }
+        }
+
+        position_ = in.pos;
+        return output.pos;
+    }
+
+    ZSTD_DStream* zstd_ = nullptr;
+#endif
+
+    std::string_view input_;
+    Compression compression_;
+    size_t position_ = 0;  // Input bytes handed to the library so far
+    bool done_ = false;
+    std::string error_;
+};
+
+
+// All of a compressed input, decompressed into one string
+
+inline std::string decompress_all(std::string_view input, Compression compression,
+                                  const std::string& name) {
+    require_compression(compression, name);
+    Decompressor decompressor(input, compression);
+
+    std::string result;
+    size_t block = size_t(1) << 20;
+    while (true) {
+        size_t old_size = result.size();
+        result.resize(old_size + block);
+        size_t got = decompressor.read(std::span<char>(result.data() + old_size, block));
+        result.resize(old_size + got);
+        if (got < block) break;
+        block = std::min(block * 2, size_t(64) << 20);
+    }
+
+    if (!decompressor.error().empty()) {
+        std::cerr << "Error: Could not decompress " << name << ": " << decompressor.error()
+                  << std::endl;
+        exit(1);
+    }
+    return result;
+}
+
+
+// ============================================================================
+// READ-ONLY INPUT
+// ============================================================================
+
+class MappedInput {
+public:
+    // Reads all of stdin (buffered - stdin can't be mapped)
+    MappedInput() {
+        fallback_ = read_all(STDIN_FILENO, "stdin");
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+        decompress("stdin");
+    }
+
+    // Maps a file read-only
+    // Falls back to reading if the file isn't a regular file (e.g. a pipe)
+    // A gzip or zstd file is decompressed, unless `decompressed` is false
+    // (then the view is of the compressed bytes themselves)
+    explicit MappedInput(const std::string& filename, bool decompressed = true) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error: Could not open file " << filename << std::endl;
+            exit(1);
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            size_ = static_cast<size_t>(info.st_size);
+
+            if (size_ > 0) {
+                map_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map_ == MAP_FAILED) {
+                    std::cerr << "Error: Could not map file " << filename << std::endl;
+                    exit(1);
+                }
+                // We read front to back, so let the kernel read ahead
+                ::madvise(map_, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(map_);
+            }
+        } else {
+            fallback_ = read_all(fd, filename);
+            data_ = fallback_.data();
+            size_ = fallback_.size();
+        }
+
+        ::close(fd);
+        if (decompressed) decompress(filename);
+    }
+
+    ~MappedInput() {
+        if (map_ != nullptr) ::munmap(map_, size_);
+    }
+
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    // Replaces compressed contents by the decompressed text
+    void decompress(const std::string& name) {
+        Compression compression = detect_compression(view());
+        if (compression == Compression::NONE) return;
+
+        std::string text = decompress_all(view(), compression, name);
+        if (map_ != nullptr) {
+            ::munmap(map_, size_);
+            map_ = nullptr;
+        }
+        fallback_ = std::move(text);
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+    }
+
+    const char* data_ = "";
+    size_t size_ = 0;
+    void* map_ = nullptr;
+    std::string fallback_;  // Owns the bytes when the input isn't mapped
+};
+
+
+// ============================================================================
+// WRITABLE MAPPING
+// ============================================================================
+// MAP_SHARED means stores into the mapping go straight to the file.
+
+class WritableMap {
+public:
+    // Creates (or truncates) a file of exactly `size` bytes and maps it
+    WritableMap(const std::string& filename, size_t size) {
+        int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            std::cerr << "Error: Could not write to file " << filename << std::endl;
+            exit(1);
+        }
+        map(fd, size, filename);
+    }
+
+    // Maps an existing file for reading and writing, to transform in place
+    explicit WritableMap(const std::string& filename) {
+        int fd = ::open(filename.c_str(), O_RDWR);
+        struct stat info;
+        if (fd < 0 || ::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            std::cerr << "Error: Could not open file " << filename
+                      << " for in-place writing" << std::endl;
+            exit(1);
+        }
+        map(fd, static_cast<size_t>(info.st_size), filename);
+    }
+
+    ~WritableMap() {
+        if (data_ != nullptr) ::munmap(data_, size_);
+    }
+
+    WritableMap(const WritableMap&) = delete;
+    WritableMap& operator=(const WritableMap&) = delete;
+
+    char* data() { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void map(int fd, size_t size, const std::string& filename) {
+        size_ = size;
+        if (size_ > 0) {
+            void* map = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                std::cerr << "Error: Could not map file " << filename << std::endl;
+                exit(1);
+            }
+            data_ = static_cast<char*>(map);
+        }
+        ::close(fd);
+    }
+
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+
+// ============================================================================
+// PIPELINED READING
+// ============================================================================
+// A BlockReader owns a small ring of block buffers and a thread that fills
+// them: it decompresses (or, for a plain file, copies from the mapping)
+// into every free buffer while the caller works on the one it was handed.
+// Reading and computing overlap, and memory stays at READ_AHEAD_BLOCKS
+// blocks however large the file is.
+
+const size_t READ_AHEAD_BLOCKS = 4;
+
+class BlockReader {
+public:
+    BlockReader(const std::string& filename, size_t block_size)
+        : name_(filename), input_(filename, false),
+          compression_(detect_compression(input_.view())) {
+        require_compression(compression_, filename);
+        buffers_.assign(READ_AHEAD_BLOCKS, std::vector<char>(block_size));
+        for (size_t i = 0; i < buffers_.size(); i++) free_.push_back(i);
+        worker_ = std::thread([this]() { produce(); });
+    }
+
+    ~BlockReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        worker_.join();
+    }
+
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    Compression compression() const { return compression_; }
+
+    // The next block, the caller's to read and modify until the next call
+    // Empty at the end of the input
+    std::span<char> next() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (current_ < buffers_.size()) {
+            free_.push_back(current_);
+            current_ = buffers_.size();
+            changed_.notify_all();
+        }
+
+        changed_.wait(lock, [&]() { return !filled_.empty() || finished_; });
+        if (filled_.empty()) {
+            if (!error_.empty()) {
+                std::cerr << "Error: Could not decompress " << name_ << ": " << error_ << std::endl;
+                exit(1);
+            }
+            return {};
+        }
+
+        auto [index, length] = filled_.front();
+        filled_.pop_front();
+        current_ = index;
+        return std::span<char>(buffers_[index].data(), length);
+    }
+
+private:
+    // The reading thread: fills free buffers until the input ends
+    void produce() {
+        Decompressor decompressor(input_.view(), compression_);
+
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                changed_.wait(lock, [&]() { return !free_.empty() || stopping_; });
+                if (stopping_) return;
+                index = free_.front();
+                free_.pop_front();
+            }
+
+            size_t length = decompressor.read(buffers_[index]);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (length > 0) filled_.emplace_back(index, length);
+                if (length < buffers_[index].size()) {
+                    finished_ = true;
+                    error_ = decompressor.error();
+                }
+            }
+            changed_.notify_all();
+            if (length < buffers_[index].size()) return;
+        }
+    }
+
+    std::string name_;
+    MappedInput input_;  // The compressed bytes
+    Compression compression_;
+    std::vector<std::vector<char>> buffers_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<size_t> free_;                         // Buffers the thread may fill
+    std::deque<std::pair<size_t, size_t>> filled_;    // (buffer, length), in order
+    size_t current_ = size_t(-1);                     // The caller's buffer
+    bool finished_ = false;
+    bool stopping_ = false;
+    std::string error_;
+    std::thread worker_;
+};
+
+
+// ============================================================================
+// COMPRESSED OUTPUT
+// ============================================================================
+
+// Compression levels of written files: the gzip and zstd defaults
+const int GZIP_LEVEL = 6;
+const int ZSTD_LEVEL = 3;
+
+// Compressed bytes collected before each write to the file
+const size_t COMPRESS_BUFFER = size_t(1) << 18;
+
+
+// Writes a file plain, gzip or zstd; finish() must be called at the end
+// (it writes out what the compressor still holds)
+
+class CompressedOutput {
+public:
+    CompressedOutput(const std::string& filename, Compression compression)
+        : name_(filename), compression_(compression), out_(filename, std::ios::binary),
+          buffer_(COMPRESS_BUFFER) {
+        require_compression(compression, filename);
+        if (!out_.is_open()) fail();
+
+#ifdef CIPHER_HAVE_ZLIB
+        // 15 + 16: the largest window, with a gzip header and trailer
+        if (compression_ == Compression::GZIP &&
+            deflateInit2(&gzip_, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            fail();
+        }
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+        if (compression_ == Compression::ZSTD) {
+            zstd_ = ZSTD_createCCtx();
+            if (zstd_ == nullptr) fail();
+            ZSTD_CCtx_setParameter(zstd_, ZSTD_c_compressionLevel, ZSTD_LEVEL);
+        }
+#endif
+    }
+
+    ~CompressedOutput() {
+#ifdef CIPHER_HAVE_ZLIB
+        if (compression_ == Compression::GZIP) deflateEnd(&gzip_);
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+        if (zstd_ != nullptr) ZSTD_freeCCtx(zstd_);
+#endif
+    }
+
+    CompressedOutput(const CompressedOutput&) = delete;
+    CompressedOutput& operator=(const CompressedOutput&) = delete;
+
+    void write(std::span<const char> data) {
+        if (compression_ == Compression::NONE) {
+            out_.write(data.data(), data.size());
+        } else {
+            compress(data, false);
+        }
+        if (!out_) fail();
+    }
+
+    void finish() {
+        if (compression_ != Compression::NONE) compress({}, true);
+        out_.flush();
+        if (!out_) fail();
+    }
+
+private:
+    // Feeds data to the compressor, writing whatever comes out; with
+    // last, also ends the stream
+    void compress(std::span<const char> data, bool last) {
+#ifdef CIPHER_HAVE_ZLIB
+        if (compression_ == Compression::GZIP) {
+            const size_t PIECE = size_t(1) << 30;  // zlib counts in 32 bits
+            size_t offset = 0;
+            do {
+                size_t length = std::min(PIECE, data.size() - offset);
+                gzip_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data() + offset));
+                gzip_.avail_in = static_cast<uInt>(length);
+                offset += length;
+                int flush = last && offset == data.size() ? Z_FINISH : Z_NO_FLUSH;
+
+                int status;
+                do {
+                    gzip_.next_out = reinterpret_cast<Bytef*>(buffer_.data());
+                    gzip_.avail_out = static_cast<uInt>(buffer_.size());
+                    status = deflate(&gzip_, flush);
+                    if (status == Z_STREAM_ERROR) fail();
+                    out_.write(buffer_.data(), buffer_.size() - gzip_.avail_out);
+                } while (gzip_.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+            } while (offset < data.size());
+        }
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+        if (compression_ == Compression::ZSTD) {
+            ZSTD_inBuffer in = {data.data(), data.size(), 0};
+            ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+            size_t remaining;
+            do {
+                ZSTD_outBuffer output = {buffer_.data(), buffer_.size(), 0};
+                remaining = ZSTD_compressStream2(zstd_, &output, &in, mode);
+                if (ZSTD_isError(remaining)) fail();
+                out_.write(buffer_.data(), output.pos);
+            } while (last ? remaining != 0 : in.pos < in.size);
+        }
+#endif
+        (void)data;
+        (void)last;
+    }
+
+    [[noreturn]] void fail() {
+        std::cerr << "Error: Could not write to file " << name_ << std::endl;
+        exit(1);
+    }
+
+    std::string name_;
+    Compression compression_;
+    std::ofstream out_;
+    std::vector<char> buffer_;
+#ifdef CIPHER_HAVE_ZLIB
+    z_stream gzip_ = {};
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+    ZSTD_CCtx* zstd_ = nullptr;
+#endif
+};
+
+#endif  // CIPHER_IO_H
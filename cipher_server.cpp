@@ -0,0 +1,619 @@
+// ============================================================================
+// CIPHER SERVER - The Tools as a Long-Running Process
+// ============================================================================
+// Starting a tool per message costs more than the message: the process
+// starts, the quadgram table is loaded, the thread pool is created - and
+// all of it is thrown away a few microseconds of real work later. The
+// server does that once and then answers requests until its input ends.
+//
+// Protocol (stdin/stdout by default, or one Unix socket per client with
+// --socket PATH): every request is a header line and a payload of
+// exactly LENGTH bytes,
+//
+//   ID COMMAND ARG LENGTH\n<payload>
+//
+// and every answer is the same shape, with the request's ID:
+//
+//   ID ok LENGTH\n<payload>        or        ID error LENGTH\n<message>
+//
+//   encrypt KEY, decrypt KEY   the payload through vigenere; KEY may be
+//                              VARIANT:KEY (beaufort:LEMON, autokey:PRIMER,
+//                              see VARIANTS in cipher.h); a running key
+//                              needs at least as many letters as the payload
+//   freq -                     {"letters":N,"counts":[...26],"ic":0.0667}
+//   crack VARIANTS             the batch-mode JSON of kasiski_attack for the
+//                              payload; VARIANTS is - (the server's
+//                              --variants), all, or a list
+//
+// A client may send many requests without waiting for the answers. Each
+// connection's answers come back in the order its requests were sent.
+//
+// Requests are not handed to the pool one at a time. Whatever has arrived
+// waits in one queue, and the dispatcher takes up to --batch-size of them
+// at once (after up to --batch-wait microseconds for more to come):
+// one parallel_for per batch and one write per client per batch, instead
+// of a wake-up and a system call for every short message. The queue holds
+// two batches (or 4 requests per thread, if more); past that, clients are
+// not read until the pool catches up.
+//
+// Compile: cmake -S . -B build && cmake --build build --target cipher_server
+// ============================================================================
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "arena.h"
+#include "cipher.h"
+#include "kasiski.h"
+#include "quadgram.h"
+#include "task_pool.h"
+
+
+// Longest header line and largest payload a request may have
+const size_t MAX_HEADER = 4096;
+const size_t MAX_PAYLOAD = size_t(256) << 20;
+
+// Bytes read from a client per system call
+const size_t READ_BLOCK = 1 << 16;
+
+
+// ============================================================================
+// CONNECTIONS - Framed Requests In, Framed Answers Out
+// ============================================================================
+
+// One client: stdin/stdout, or both directions of an accepted socket
+
+class Connection {
+public:
+    Connection(int in_fd, int out_fd, bool owns) : in_fd_(in_fd), out_fd_(out_fd), owns_(owns) {}
+
+    ~Connection() {
+        if (owns_) ::close(in_fd_);
+    }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+
+    // Reads the next request into id, command, arg and payload
+    // Returns false at the end of the input; on a header that can't be
+    // parsed, sets error too (the stream can't be trusted after that)
+    bool read_request(std::string& id, std::string& command, std::string& arg,
+                      std::string& payload, std::string& error) {
+        std::string header;
+        while (true) {
+            size_t newline = buffer_.find('\n', start_);
+            if (newline != std::string::npos) {
+                header = buffer_.substr(start_, newline - start_);
+                start_ = newline + 1;
+                break;
+            }
+            if (buffer_.size() - start_ > MAX_HEADER) {
+                error = "header line too long";
+                return false;
+            }
+            if (!fill()) {
+                if (buffer_.size() > start_) error = "incomplete request at end of input";
+                return false;
+            }
+        }
+
+        std::istringstream fields(header);
+        std::string length_field, extra;
+        size_t length = 0;
+        if (!(fields >> id >> command >> arg >> length_field) || (fields >> extra)) {
+            error = "bad header '" + header + "' (expected: ID COMMAND ARG LENGTH)";
+            return false;
+        }
+        try {
+            size_t used = 0;
+            length = std::stoull(length_field, &used);
+            if (used != length_field.size()) throw std::invalid_argument("length");
+        } catch (...) {
+            error = "bad length '" + length_field + "'";
+            return false;
+        }
+        if (length > MAX_PAYLOAD) {
+            error = "payload of " + length_field + " bytes is too large";
+            return false;
+        }
+
+        while (buffer_.size() - start_ < length) {
+            if (!fill()) {
+                error = "incomplete payload at end of input";
+                return false;
+            }
+        }
+        payload.assign(buffer_, start_, length);
+        start_ += length;
+        return true;
+    }
+
+
+    // Writes everything, retrying short writes; gives up quietly if the
+    // client has gone away
+    void send(const std::string& bytes) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        size_t sent = 0;
+        while (sent < bytes.size()) {
+            ssize_t n = ::write(out_fd_, bytes.data() + sent, bytes.size() - sent);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            sent += n;
+        }
+    }
+
+private:
+    // Reads more of the input; false at the end (or on an error)
+    bool fill() {
+        // Drop what has been used before the buffer grows
+        if (start_ > 0 && start_ >= buffer_.size() / 2) {
+            buffer_.erase(0, start_);
+            start_ = 0;
+        }
+
+        size_t old_size = buffer_.size();
+        buffer_.resize(old_size + READ_BLOCK);
+        ssize_t n;
+        do {
+            n = ::read(in_fd_, buffer_.data() + old_size, READ_BLOCK);
+        } while (n < 0 && errno == EINTR);
+
+        buffer_.resize(old_size + std::max<ssize_t>(n, 0));
+        return n > 0;
+    }
+
+    int in_fd_;
+    int out_fd_;
+    bool owns_;  // Close the descriptor when done (sockets, not stdin)
+    std::string buffer_;
+    size_t start_ = 0;  // First unread byte of buffer_
+    std::mutex write_mutex_;
+};
+
+
+// An answer frame
+
+inline std::string make_frame(const std::string& id, bool ok, const std::string& payload) {
+    return id + (ok ? " ok " : " error ") + std::to_string(payload.size()) + "\n" + payload;
+}
+
+
+// ============================================================================
+// COMMANDS - What a Request Asks For
+// ============================================================================
+
+struct ServerRequest {
+    std::shared_ptr<Connection> connection;
+    std::string id;
+    std::string command;
+    std::string arg;
+    std::string payload;
+
+    bool ok = false;
+    std::string answer;  // Result payload, or the error message
+};
+
+
+// Splits ARG of encrypt/decrypt into variant and key
+// Returns false (and an error) for an unknown variant or a bad key
+
+inline bool parse_key_arg(const std::string& arg, CipherVariant& variant, std::string& key,
+                          std::string& error) {
+    variant = CipherVariant::VIGENERE;
+    key = arg;
+
+    size_t colon = arg.find(':');
+    if (colon != std::string::npos) {
+        if (!parse_variant(arg.substr(0, colon), variant)) {
+            error = "unknown variant " + arg.substr(0, colon);
+            return false;
+        }
+        key = arg.substr(colon + 1);
+    }
+
+    bool letters = !key.empty() && std::all_of(key.begin(), key.end(), [](char c) {
+        return std::isalpha(static_cast<unsigned char>(c)) != 0;
+    });
+    if (!letters) {
+        error = "key must be letters only";
+        return false;
+    }
+    return true;
+}
+
+
+// A running key shorter than the payload would wrap around and repeat,
+// as vigenere refuses too. Returns false (and an error) if it would
+
+inline bool check_running_key(const std::string& key, const std::string& payload,
+                              std::string& error) {
+    uint64_t counts[26];
+    count_letters(payload, counts);
+    uint64_t letters = 0;
+    for (uint64_t count : counts) letters += count;
+
+    if (key.size() < letters) {
+        error = "running key has " + std::to_string(key.size()) + " letters, but the payload" +
+                " has " + std::to_string(letters) + " - the key would repeat";
+        return false;
+    }
+    return true;
+}
+
+
+// Letter counts and index of coincidence of a payload, as JSON
+
+inline std::string frequency_json(const std::string& text) {
+    uint64_t counts[26];
+    count_letters(text, counts);
+
+    uint64_t total = 0;
+    double pairs = 0.0;
+    for (int i = 0; i < 26; i++) {
+        total += counts[i];
+        pairs += static_cast<double>(counts[i]) * (counts[i] > 0 ? counts[i] - 1 : 0);
+    }
+    double ic = total > 1 ? pairs / (static_cast<double>(total) * (total - 1)) : 0.0;
+
+    std::ostringstream out;
+    out << "{\"letters\":" << total << ",\"counts\":[";
+    for (int i = 0; i < 26; i++) out << (i > 0 ? "," : "") << counts[i];
+    out << "],\"ic\":" << std::fixed << std::setprecision(6) << ic << "}";
+    return out.str();
+}
+
+
+// Runs one request, filling in ok and answer
+
+inline void handle_request(ServerRequest& request, const CrackSettings& defaults) {
+    const std::string& command = request.command;
+
+    if (command == "encrypt" || command == "decrypt") {
+        CipherVariant variant;
+        std::string key;
+        request.ok = parse_key_arg(request.arg, variant, key, request.answer);
+        if (request.ok && variant == CipherVariant::RUNNING_KEY) {
+            request.ok = check_running_key(key, request.payload, request.answer);
+        }
+        if (request.ok) {
+            request.answer = variant_process(request.payload, key, variant,
+                                             command == "encrypt" ? 1 : -1);
+        }
+    } else if (command == "freq") {
+        request.ok = true;
+        request.answer = frequency_json(request.payload);
+    } else if (command == "crack") {
+        CrackSettings settings = defaults;
+        if (request.arg != "-" && !parse_variant_list(request.arg, settings.variants)) {
+            request.answer = "bad variant list " + request.arg;
+            return;
+        }
+        std::string ciphertext = clean_text(request.payload);
+        request.ok = true;
+        request.answer = crack_result_json(request.id, ciphertext.length(),
+                                           crack_message(ciphertext, settings));
+    } else {
+        request.answer = "unknown command " + command + " (encrypt, decrypt, freq, crack)";
+    }
+}
+
+
+// ============================================================================
+// BATCHING - One Queue, Many Requests per Trip to the Pool
+// ============================================================================
+
+// At most `capacity` requests wait in the queue (never less than a
+// batch): past that, push blocks, so a client sending faster than the
+// pool answers stops being read instead of filling memory
+
+class RequestBatcher {
+public:
+    RequestBatcher(size_t batch_size, std::chrono::microseconds batch_wait, size_t capacity)
+        : batch_size_(batch_size), batch_wait_(batch_wait),
+          capacity_(std::max(capacity, batch_size)) {}
+
+    // Waits while the queue is full; after close() the request is dropped
+    void push(std::unique_ptr<ServerRequest> request) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            space_.wait(lock, [&]() { return queue_.size() < capacity_ || closed_; });
+            if (closed_) return;
+            queue_.push_back(std::move(request));
+        }
+        ready_.notify_one();
+    }
+
+    // No more requests will come: next_batch returns the rest, then false
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_one();
+        space_.notify_all();
+    }
+
+    // Blocks for the next batch: every request that has arrived, up to
+    // batch_size, waiting up to batch_wait for a short batch to fill
+    bool next_batch(std::vector<std::unique_ptr<ServerRequest>>& batch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [&]() { return !queue_.empty() || closed_; });
+        if (queue_.empty()) return false;
+
+        if (batch_wait_.count() > 0 && queue_.size() < batch_size_ && !closed_) {
+            ready_.wait_for(lock, batch_wait_,
+                            [&]() { return queue_.size() >= batch_size_ || closed_; });
+        }
+
+        batch.clear();
+        while (!queue_.empty() && batch.size() < batch_size_) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        lock.unlock();
+        space_.notify_all();
+        return true;
+    }
+
+private:
+    size_t batch_size_;
+    std::chrono::microseconds batch_wait_;
+    size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable ready_;   // Requests arrived, or closed
+    std::condition_variable space_;   // The queue has room, or closed
+    std::deque<std::unique_ptr<ServerRequest>> queue_;
+    bool closed_ = false;
+};
+
+
+// Counts for the summary on stderr when the server stops
+struct ServerStats {
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    uint64_t errors = 0;
+};
+
+
+// The dispatcher: runs batch after batch until the batcher is closed
+// Answers go out in queue order, so each client's stay in its own order;
+// consecutive answers to one client are sent with one write
+
+inline ServerStats dispatch(RequestBatcher& batcher, const CrackSettings& settings) {
+    ServerStats stats;
+    std::vector<std::unique_ptr<ServerRequest>> batch;
+
+    while (batcher.next_batch(batch)) {
+        auto run = [&](size_t i) {
+            ArenaScope scope;  // Each request's scratch, rewound when it's answered
+            handle_request(*batch[i], settings);
+        };
+        if (settings.pool != nullptr) {
+            settings.pool->parallel_for(batch.size(), run);
+        } else {
+            for (size_t i = 0; i < batch.size(); i++) run(i);
+        }
+
+        std::string pending;
+        for (size_t i = 0; i < batch.size(); i++) {
+            ServerRequest& request = *batch[i];
+            pending += make_frame(request.id, request.ok, request.answer);
+            stats.errors += request.ok ? 0 : 1;
+
+            bool last_for_client = i + 1 == batch.size() ||
+                                   batch[i + 1]->connection != request.connection;
+            if (last_for_client) {
+                request.connection->send(pending);
+                pending.clear();
+            }
+        }
+
+        stats.requests += batch.size();
+        stats.batches++;
+    }
+
+    return stats;
+}
+
+
+// Reads one client's requests into the batcher until its input ends
+// A broken header gets an error answer with ID "-", and the client is
+// dropped: after it, frame boundaries can't be found again
+
+inline void read_client(std::shared_ptr<Connection> connection, RequestBatcher& batcher) {
+    while (true) {
+        auto request = std::make_unique<ServerRequest>();
+        std::string error;
+        if (!connection->read_request(request->id, request->command, request->arg,
+                                      request->payload, error)) {
+            if (!error.empty()) connection->send(make_frame("-", false, error));
+            return;
+        }
+        request->connection = connection;
+        batcher.push(std::move(request));
+    }
+}
+
+
+// ============================================================================
+// MAIN PROGRAM
+// ============================================================================
+
+struct ServerOptions {
+    std::string socket_path;    // --socket PATH: listen on a Unix socket instead of stdin
+    std::string quadgram_file;  // --quadgrams FILE
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());  // --threads N
+    size_t batch_size = 64;     // --batch-size N: most requests per trip to the pool
+    int batch_wait = 0;         // --batch-wait US: how long a short batch may wait to fill
+    CrackSettings crack;        // --max-key N, --top-k N, --scoring chi|corr|quad,
+                                // --restarts N, --variants LIST
+};
+
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--socket PATH] [--quadgrams FILE] [--threads N]"
+              << " [--batch-size N] [--batch-wait US]\n"
+              << "       [--max-key N] [--top-k N] [--scoring chi|corr|quad] [--restarts N]"
+              << " [--variants LIST]\n"
+              << "Requests: ID COMMAND ARG LENGTH\\n<LENGTH bytes>, answers: ID ok|error"
+              << " LENGTH\\n<LENGTH bytes>\n"
+              << "Commands: encrypt KEY, decrypt KEY (KEY may be VARIANT:KEY), freq -,"
+              << " crack -|VARIANTS" << std::endl;
+}
+
+
+ServerOptions parse_options(int argc, char* argv[]) {
+    ServerOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--socket" && has_value) {
+            options.socket_path = argv[++i];
+        } else if (arg == "--quadgrams" && has_value) {
+            options.quadgram_file = argv[++i];
+        } else if (arg == "--threads" && has_value) {
+            options.threads = parse_int_flag(arg, argv[++i], 1, 1024);
+        } else if (arg == "--batch-size" && has_value) {
+            options.batch_size = parse_int_flag(arg, argv[++i], 1, 1 << 20);
+        } else if (arg == "--batch-wait" && has_value) {
+            options.batch_wait = parse_int_flag(arg, argv[++i], 0, 1000000);
+        } else if (arg == "--max-key" && has_value) {
+            options.crack.max_key_len = parse_int_flag(arg, argv[++i], 2, 10000);
+        } else if (arg == "--top-k" && has_value) {
+            options.crack.top_k = parse_int_flag(arg, argv[++i], 1, 10000);
+        } else if (arg == "--restarts" && has_value) {
+            options.crack.restarts = parse_int_flag(arg, argv[++i], 0, 100000);
+        } else if (arg == "--scoring" && has_value) {
+            std::string method = argv[++i];
+            if (method == "chi") {
+                options.crack.scoring = ShiftScore::CHI_SQUARED;
+            } else if (method == "corr") {
+                options.crack.scoring = ShiftScore::CORRELATION;
+            } else if (method == "quad") {
+                options.crack.scoring = ShiftScore::QUADGRAM;
+            } else {
+                std::cerr << "Error: --scoring must be 'chi', 'corr' or 'quad'" << std::endl;
+                exit(1);
+            }
+        } else if (arg == "--variants" && has_value) {
+            if (!parse_variant_list(argv[++i], options.crack.variants)) {
+                std::cerr << "Error: --variants takes 'all' or a list of vigenere, beaufort,"
+                          << " variant-beaufort and autokey" << std::endl;
+                exit(1);
+            }
+        } else {
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    return options;
+}
+
+
+// The quadgram table, loaded once for every request after it:
+// --quadgrams FILE, then a compiled-in table, then letter frequencies
+
+QuadgramTable load_quadgrams(const ServerOptions& options) {
+    QuadgramTable table = QuadgramTable::from_letter_frequencies(ENGLISH_FREQ);
+
+    if (!options.quadgram_file.empty()) {
+        if (!table.load(options.quadgram_file)) exit(1);
+    } else if (!table.load_embedded()) {
+        std::cerr << "Warning: no quadgram table given (--quadgrams FILE), "
+                  << "using letter frequencies instead" << std::endl;
+    }
+    return table;
+}
+
+
+// Listens on a Unix socket; every client gets a reader thread, and all
+// of them feed the same batcher. Runs until the process is stopped
+
+void serve_socket(const std::string& path, RequestBatcher& batcher) {
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Could not create socket " << path << std::endl;
+        exit(1);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    ::unlink(path.c_str());  // A socket left behind by an earlier run
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, 64) != 0) {
+        std::cerr << "Error: Could not listen on socket " << path << std::endl;
+        exit(1);
+    }
+
+    while (true) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: accept failed on socket " << path << std::endl;
+            exit(1);
+        }
+        auto connection = std::make_shared<Connection>(client, client, true);
+        std::thread(read_client, connection, std::ref(batcher)).detach();
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    ServerOptions options = parse_options(argc, argv);
+
+    // A client that hangs up must not take the server with it
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // Everything a request needs is set up here, once
+    QuadgramTable quadgrams = load_quadgrams(options);
+    options.crack.quadgrams = &quadgrams;
+
+    // The dispatcher is one of the threads
+    TaskPool pool(options.threads - 1);
+    if (options.threads > 1) options.crack.pool = &pool;
+
+    // Room for the next batch while one runs, and like kasiski_attack
+    // --batch, 4 requests per thread read ahead
+    size_t capacity = std::max<size_t>(2 * options.batch_size, 4 * options.threads);
+    RequestBatcher batcher(options.batch_size, std::chrono::microseconds(options.batch_wait),
+                           capacity);
+    ServerStats stats;
+    std::thread dispatcher([&]() { stats = dispatch(batcher, options.crack); });
+
+    std::cerr << "cipher_server: ready on "
+              << (options.socket_path.empty() ? "stdin/stdout" : options.socket_path)
+              << " (" << options.threads << " threads)" << std::endl;
+
+    if (!options.socket_path.empty()) {
+        serve_socket(options.socket_path, batcher);
+    }
+
+    read_client(std::make_shared<Connection>(STDIN_FILENO, STDOUT_FILENO, false), batcher);
+    batcher.close();
+    dispatcher.join();
+
+    std::cerr << "cipher_server: " << stats.requests << " requests (" << stats.errors
+              << " errors) in " << stats.batches << " batches" << std::endl;
+    return 0;
+}
@@ -0,0 +1,652 @@
+// ============================================================================
+// CIPHER TEST - Checks the Fast Paths Against the Slow Ones
+// ============================================================================
+// Every optimisation in the shared headers has a simple version it must
+// agree with. This program runs both on random inputs and compares:
+//
+//   kernels      - every SIMD kernel this CPU has, and the fixed-length
+//                  scalar kernels, against shift_scalar: key lengths
+//                  1..40, random phases, lengths with odd tails
+//   threads      - apply_schedule_parallel and stream_file with several
+//                  threads against one thread, byte for byte
+//   repeats      - find_long_repeats (suffix array + LCP) against a
+//                  brute-force search of every substring, and the n-grams
+//                  read off the suffix array against find_repeated_sequences
+//   columnar_ic  - the folded base-period counts against building every
+//                  column string and calling calculate_ic
+//   variants     - encrypt then decrypt for every CipherVariant, whole
+//                  and block by block
+//   letter_files - write_letter_file then decode_letter_file, packed and
+//                  not, and the .idx offsets against the original text
+//   compression  - gzip and zstd files (in builds that have them) written
+//                  and read by us and by the gzip and zstd programs
+//
+// Prints one line per failure and a summary; exits 1 if anything failed.
+// The seed is fixed, so a failure repeats on the next run.
+//
+// Compile and run:
+//   cmake -S . -B build && cmake --build build && ctest --test-dir build
+// ============================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "cipher.h"
+#include "kasiski.h"
+#include "letter_file.h"
+
+
+// ============================================================================
+// CHECKS
+// ============================================================================
+
+int checks = 0;
+int failures = 0;
+
+// Counts a check and prints what went wrong if it failed
+#define CHECK(condition, what)                                                  \
+    do {                                                                        \
+        checks++;                                                               \
+        if (!(condition)) {                                                     \
+            failures++;                                                         \
+            std::ostringstream message;                                         \
+            message << what;                                                    \
+            std::cerr << "FAIL " << __LINE__ << ": " << message.str() << "\n";  \
+        }                                                                       \
+    } while (0)
+
+
+std::mt19937_64 rng(20240601);
+
+size_t random_below(size_t n) {
+    return std::uniform_int_distribution<size_t>(0, n - 1)(rng);
+}
+
+
+// Bytes with every class the kernels tell apart: upper and lower case
+// letters, the bytes just outside them ('@', '[', '`', '{'), and high bytes
+
+std::string random_bytes(size_t length) {
+    static const std::string edges = "@[`{ \n.,0129";
+    std::string text(length, '\0');
+
+    for (char& c : text) {
+        switch (random_below(5)) {
+            case 0:  c = static_cast<char>('A' + random_below(26)); break;
+            case 1:  c = static_cast<char>('a' + random_below(26)); break;
+            case 2:  c = edges[random_below(edges.size())]; break;
+            case 3:  c = static_cast<char>(random_below(256)); break;
+            default: c = static_cast<char>('a' + random_below(26)); break;
+        }
+    }
+    return text;
+}
+
+
+// Uppercase A-Z text over the first `alphabet` letters
+// A small alphabet makes plenty of repeats
+
+std::string random_letters(size_t length, int alphabet = 26) {
+    std::string text(length, 'A');
+    for (char& c : text) c = static_cast<char>('A' + random_below(alphabet));
+    return text;
+}
+
+
+// A key of `length` letters (shifts 0-25)
+
+std::vector<int> random_key(size_t length) {
+    std::vector<int> key(length);
+    for (int& shift : key) shift = static_cast<int>(random_below(26));
+    return key;
+}
+
+
+// English-looking letters: Vigenère of sample text repeated, so the
+// column ICs differ by key length the way real ciphertext does
+
+std::string english_cipher(size_t length, const std::string& key) {
+    static const std::string words =
+        "THEQUICKBROWNFOXJUMPSOVERTHELAZYDOGANDTHENRUNSAWAYINTOTHEFORESTWHERE"
+        "NOONECANFINDITEXCEPTTHEOWLWHOSEESEVERYTHINGATNIGHTFROMHIGHINTHETREES";
+    std::string plain(length, 'A');
+    for (size_t i = 0; i < length; i++) plain[i] = words[random_below(words.size())];
+    for (size_t i = 0; i + 40 < length; i += 97) {
+        plain.replace(i, 20, words.substr(random_below(words.size() - 20), 20));
+    }
+    return vigenere_encrypt(plain, key);
+}
+
+
+// Name for a scratch file in the temp directory, unique to this run
+
+std::string temp_name(const std::string& suffix) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path();
+    return (dir / ("cipher_test_" + std::to_string(::getpid()) + suffix)).string();
+}
+
+
+// All bytes of a file as they are on disk
+
+std::string read_file_bytes(const std::string& name) {
+    std::ifstream in(name, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+
+// ============================================================================
+// KERNELS - Every ISA Path Against shift_scalar
+// ============================================================================
+
+struct NamedKernel {
+    std::string name;
+    ShiftKernel kernel;
+    size_t key_length;  // The only key length it handles (0 = any)
+};
+
+
+// The kernels this CPU can run, besides shift_scalar itself
+
+std::vector<NamedKernel> available_kernels() {
+    std::vector<NamedKernel> kernels;
+
+    for (size_t k = 0; k < MAX_FIXED_KEY; k++) {
+        kernels.push_back({"shift_scalar_fixed<" + std::to_string(k + 1) + ">",
+                           FIXED_SCALAR_KERNELS[k], k + 1});
+    }
+
+#if defined(SHIFT_KERNEL_X86)
+    if (__builtin_cpu_supports("sse4.2")) {
+        kernels.push_back({"shift_sse42<true>", shift_sse42<true>, 1});
+        kernels.push_back({"shift_sse42<false>", shift_sse42<false>, 0});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"shift_avx2<true>", shift_avx2<true>, 1});
+        kernels.push_back({"shift_avx2<false>", shift_avx2<false>, 0});
+    }
+#elif defined(SHIFT_KERNEL_NEON)
+    kernels.push_back({"shift_neon<true>", shift_neon<true>, 1});
+    kernels.push_back({"shift_neon<false>", shift_neon<false>, 0});
+#endif
+
+    return kernels;
+}
+
+
+void test_kernels() {
+    std::vector<NamedKernel> kernels = available_kernels();
+    std::cout << "kernels: shift_scalar_fixed<1.." << MAX_FIXED_KEY << ">";
+    for (const NamedKernel& k : kernels) {
+        if (k.name.rfind("shift_scalar", 0) != 0) std::cout << ", " << k.name;
+    }
+    std::cout << "\n";
+
+    for (size_t key_length = 1; key_length <= 40; key_length++) {
+        for (int direction : {1, -1}) {
+            ShiftSchedule schedule = make_schedule(random_key(key_length), direction);
+
+            for (int trial = 0; trial < 20; trial++) {
+                // Whole vectors plus an odd tail, sometimes shorter than one vector
+                size_t length = trial < 8 ? random_below(40) : 64 * random_below(8) + random_below(64);
+                std::string input = random_bytes(length);
+                size_t start = random_below(schedule.period);
+
+                std::string expected = input;
+                size_t expected_phase = start;
+                shift_scalar(reinterpret_cast<uint8_t*>(expected.data()), length, schedule,
+                             expected_phase);
+
+                for (const NamedKernel& k : kernels) {
+                    if (k.key_length != 0 && k.key_length != key_length) continue;
+
+                    std::string actual = input;
+                    size_t phase = start;
+                    k.kernel(reinterpret_cast<uint8_t*>(actual.data()), length, schedule, phase);
+
+                    CHECK(actual == expected, k.name << " key length " << key_length
+                          << " direction " << direction << " phase " << start << " length "
+                          << length << ": output differs from shift_scalar");
+                    // Kernels may return the phase within the key rather than the period
+                    CHECK(phase % key_length == expected_phase % key_length,
+                          k.name << " key length " << key_length << " phase " << start
+                          << " length " << length << ": ends at phase " << phase
+                          << ", shift_scalar at " << expected_phase);
+                }
+            }
+        }
+    }
+}
+
+
+// ============================================================================
+// THREADS - Several Threads Against One
+// ============================================================================
+
+void test_threads() {
+    // Enough for every thread to get a slice of its own (MIN_SLICE is 64 KB)
+    std::string input = random_bytes((size_t(1) << 20) + 12345);
+
+    for (unsigned threads : {2u, 3u, 8u}) {
+        TaskPool pool(threads - 1);
+
+        for (size_t key_length : {size_t(1), size_t(2), size_t(7), size_t(26), size_t(37)}) {
+            for (bool reflect : {false, true}) {
+                ShiftSchedule schedule = make_schedule(random_key(key_length), 1);
+                schedule.reflect = reflect;
+                size_t start = random_below(1000);
+
+                std::string expected = input;
+                size_t expected_pos = start;
+                apply_schedule(expected.data(), expected.size(), schedule, expected_pos);
+
+                std::string actual = input;
+                size_t key_pos = start;
+                apply_schedule_parallel(actual.data(), actual.size(), schedule, key_pos, &pool);
+
+                CHECK(actual == expected, threads << " threads, key length " << key_length
+                      << (reflect ? " (Beaufort)" : "") << ": output differs from one thread");
+                CHECK(key_pos % key_length == expected_pos % key_length,
+                      threads << " threads, key length " << key_length << ": ends at key phase "
+                      << key_pos << ", one thread at " << expected_pos);
+            }
+        }
+
+        uint64_t expected_counts[26], counts[26];
+        count_letters(input, expected_counts);
+        count_letters_parallel(input, counts, &pool);
+        CHECK(std::equal(counts, counts + 26, expected_counts),
+              threads << " threads: count_letters_parallel differs from count_letters");
+    }
+
+    // The whole --threads path of vigenere: stream_file, block after block
+    std::string in_name = temp_name(".txt");
+    std::string big = random_bytes(3 * CHUNK_SIZE + 777);
+    std::ofstream(in_name, std::ios::binary).write(big.data(), big.size());
+
+    ShiftSchedule schedule = make_schedule(std::string("LEMONADE"), 1);
+    stream_file(in_name, temp_name(".1"), schedule, 1);
+    std::string one_thread = read_file_bytes(temp_name(".1"));
+    CHECK(one_thread == vigenere_encrypt(big, "LEMONADE"),
+          "stream_file: output differs from vigenere_encrypt");
+
+    for (unsigned threads : {2u, 5u}) {
+        std::string name = temp_name("." + std::to_string(threads));
+        stream_file(in_name, name, schedule, threads);
+        CHECK(read_file_bytes(name) == one_thread,
+              "stream_file with " << threads << " threads differs from one thread");
+        mmap_file(in_name, name, schedule, threads);
+        CHECK(read_file_bytes(name) == one_thread,
+              "mmap_file with " << threads << " threads differs from one thread");
+        std::filesystem::remove(name);
+    }
+    std::filesystem::remove(temp_name(".1"));
+    std::filesystem::remove(in_name);
+}
+
+
+// ============================================================================
+// REPEATS - Suffix Array Against Brute Force
+// ============================================================================
+
+// Every maximal repeat of at least min_length letters, the slow way:
+// list every substring's occurrences, then keep the ones that can't be
+// extended to the right or left at all the same places
+
+std::set<std::pair<int, std::vector<int>>> brute_force_repeats(const std::string& text,
+                                                               int min_length) {
+    int n = static_cast<int>(text.length());
+    std::map<std::string, std::vector<int>> occurrences;
+    for (int i = 0; i < n; i++) {
+        for (int length = min_length; i + length <= n; length++) {
+            occurrences[text.substr(i, length)].push_back(i);
+        }
+    }
+
+    std::set<std::pair<int, std::vector<int>>> repeats;
+    for (const auto& [sequence, positions] : occurrences) {
+        if (positions.size() < 2) continue;
+        int length = static_cast<int>(sequence.length());
+
+        // The letters after and before each occurrence; the ends of the
+        // text count as letters of their own that nothing else matches
+        std::set<int> after, before;
+        for (int pos : positions) {
+            after.insert(pos + length == n ? -1 - pos : text[pos + length]);
+            before.insert(pos == 0 ? -1 : text[pos - 1]);
+        }
+        bool right_maximal = after.size() > 1;
+        bool left_maximal = before.size() > 1 || *before.begin() == -1;
+
+        if (right_maximal && left_maximal) repeats.insert({length, positions});
+    }
+    return repeats;
+}
+
+
+void test_repeats() {
+    for (int trial = 0; trial < 300; trial++) {
+        size_t length = 1 + random_below(trial < 100 ? 30 : 160);
+        int alphabet = 2 + static_cast<int>(random_below(4));
+        std::string text = random_letters(length, alphabet);
+        int min_length = 1 + static_cast<int>(random_below(6));
+
+        SuffixIndex index = build_suffix_index(text);
+
+        std::vector<int> sorted(index.sa);
+        std::sort(sorted.begin(), sorted.end(), [&](int a, int b) {
+            return text.compare(a, std::string::npos, text, b, std::string::npos) < 0;
+        });
+        CHECK(index.sa == sorted, "suffix array of " << text << " is not sorted");
+
+        std::set<std::pair<int, std::vector<int>>> found;
+        for (const LongRepeat& repeat : find_long_repeats(text, index, min_length)) {
+            found.insert({repeat.length, repeat.positions});
+        }
+        std::set<std::pair<int, std::vector<int>>> expected = brute_force_repeats(text, min_length);
+
+        CHECK(found == expected, "find_long_repeats(" << text << ", " << min_length << ") found "
+              << found.size() << " maximal repeats, brute force " << expected.size());
+
+        // The trigrams and tetragrams kasiski_analysis reads off the same index
+        for (int n : {3, 4}) {
+            ArenaScope scope;
+            RepeatedSequences from_index = repeated_sequences(text, index, n);
+            RepeatedSequences from_table = find_repeated_sequences(text, n);
+            CHECK(from_index.codes == from_table.codes && from_index.offsets == from_table.offsets &&
+                  from_index.positions == from_table.positions,
+                  "repeated_sequences(" << text << ", " << n << ") differs from find_repeated_sequences");
+        }
+    }
+}
+
+
+// ============================================================================
+// COLUMNAR IC - Folded Counts Against Column Strings
+// ============================================================================
+
+// Average IC of the columns for key length len, building each column
+
+double naive_column_ic(const std::string& ciphertext, int len) {
+    std::vector<std::string> columns(len);
+    for (size_t i = 0; i < ciphertext.length(); i++) columns[i % len] += ciphertext[i];
+
+    double total = 0.0;
+    for (const std::string& column : columns) total += calculate_ic(column);
+    return total / len;
+}
+
+
+void test_columnar_ic() {
+    TaskPool pool(3);
+
+    for (size_t length : {size_t(7), size_t(60), size_t(250), size_t(3000), size_t(70000)}) {
+        for (int max_length : {1, 15, 40, 210}) {
+            std::string key;
+            for (int shift : random_key(1 + random_below(12))) key += static_cast<char>('A' + shift);
+            std::string ciphertext = english_cipher(length, key);
+
+            for (TaskPool* with_pool : {static_cast<TaskPool*>(nullptr), &pool}) {
+                ArenaScope scope;
+                std::vector<double> average = columnar_ic(ciphertext, max_length, with_pool);
+                CHECK(average.size() == static_cast<size_t>(max_length) + 1,
+                      "columnar_ic returned " << average.size() << " entries for max length "
+                      << max_length);
+
+                int limit = std::min<int>(max_length, static_cast<int>(average.size()) - 1);
+                for (int len = 1; len <= limit; len++) {
+                    double expected = naive_column_ic(ciphertext, len);
+                    CHECK(std::fabs(average[len] - expected) < 1e-12,
+                          "columnar_ic of " << length << " letters, key length " << len
+                          << (with_pool ? " (pool)" : "") << ": " << average[len]
+                          << ", column strings give " << expected);
+                }
+            }
+        }
+    }
+}
+
+
+// ============================================================================
+// VARIANTS - Round Trips
+// ============================================================================
+
+void test_variants() {
+    CHECK(vigenere_encrypt("ATTACK AT DAWN", "LEMON") == "LXFOPV EF RNHR",
+          "vigenere_encrypt of ATTACK AT DAWN with LEMON");
+    CHECK(variant_encrypt("attack", "LEMON", CipherVariant::BEAUFORT) ==
+          variant_decrypt("ATTACK", "LEMON", CipherVariant::BEAUFORT),
+          "Beaufort is not its own inverse");
+
+    for (CipherVariant variant : ALL_VARIANTS) {
+        for (int trial = 0; trial < 50; trial++) {
+            std::string text = random_bytes(random_below(3000));
+            uint64_t counts[26];
+            count_letters(text, counts);
+            uint64_t letters = 0;
+            for (uint64_t count : counts) letters += count;
+
+            // A running key is as long as the text; the others are keywords
+            size_t key_length = variant == CipherVariant::RUNNING_KEY
+                ? letters + 1 + random_below(10) : 1 + random_below(40);
+            std::string key;
+            for (int shift : random_key(key_length)) {
+                key += static_cast<char>((random_below(2) ? 'a' : 'A') + shift);
+            }
+
+            std::string upper = text;
+            for (char& c : upper) {
+                if (LETTER_BINS.bin[static_cast<uint8_t>(c)] < 26) c = static_cast<char>(c & ~0x20);
+            }
+
+            std::string cipher = variant_encrypt(text, key, variant);
+            std::string plain = variant_decrypt(cipher, key, variant);
+            CHECK(plain == upper, variant_name(variant) << " key length " << key_length
+                  << ", " << text.size() << " bytes: decrypt(encrypt(text)) is not the text");
+
+            // Block by block, carrying the key phase (or autokey state) across
+            std::string blocks = text;
+            size_t block = 1 + random_below(100);
+            if (variant == CipherVariant::AUTOKEY) {
+                AutokeyState state = make_autokey(key, 1);
+                for (size_t i = 0; i < blocks.size(); i += block) {
+                    autokey_transform(std::span<char>(blocks).subspan(
+                                          i, std::min(block, blocks.size() - i)), state);
+                }
+            } else {
+                ShiftSchedule schedule = make_variant_schedule(variant, key, 1);
+                size_t key_pos = 0;
+                for (size_t i = 0; i < blocks.size(); i += block) {
+                    transform(std::span<char>(blocks).subspan(i, std::min(block, blocks.size() - i)),
+                              schedule, key_pos);
+                }
+            }
+            CHECK(blocks == cipher, variant_name(variant) << " in blocks of " << block
+                  << " bytes differs from the whole text at once");
+        }
+    }
+}
+
+
+// ============================================================================
+// LETTER FILES - Round Trips and Index Offsets
+// ============================================================================
+// write_letter_file then decode_letter_file must give back the text's
+// letters, packed or not, whatever the count mod 8 (the packed tail); the
+// header's counts must match, and every offset the .idx gives must be
+// where that letter is in the original text.
+
+void test_letter_files() {
+    std::string name = temp_name(".let");
+
+    for (bool packed : {false, true}) {
+        // No letters, tails of every length mod 8, and several index strides
+        std::vector<size_t> lengths = {0, 1, 5, 12, 15};
+        for (int trial = 0; trial < 20; trial++) lengths.push_back(random_below(200));
+        lengths.push_back(5 * LETTER_INDEX_STRIDE + random_below(1000));  // About 3 strides of letters
+
+        for (size_t length : lengths) {
+            std::string text = random_bytes(length);
+            std::string letters;
+            std::vector<size_t> positions;
+            uint64_t counts[26] = {};
+            for (size_t i = 0; i < text.size(); i++) {
+                uint8_t pos = LETTER_BINS.bin[static_cast<uint8_t>(text[i])];
+                if (pos == 26) continue;
+                letters += static_cast<char>('A' + pos);
+                positions.push_back(i);
+                counts[pos]++;
+            }
+            std::string what = std::string(packed ? "packed" : "unpacked") + " letter file of " +
+                               std::to_string(letters.size()) + " letters";
+
+            CHECK(write_letter_file(text, name, packed), what << ": could not be written");
+            {
+                MappedInput file(name);
+                MappedInput index(name + ".idx");
+                CHECK(is_letter_file(file.view()), what << " is not recognised");
+                if (!is_letter_file(file.view())) continue;
+
+                LetterEncoding encoding = packed ? LetterEncoding::PACKED : LetterEncoding::BYTES;
+                CHECK(file.size() == sizeof(LetterFileHeader) +
+                                         letter_data_size(encoding, letters.size()),
+                      what << ": " << file.size() << " bytes");
+                CHECK(decode_letter_file(file.view(), name) == letters,
+                      what << ": decoded letters differ from the text's");
+
+                const LetterFileHeader& header = letter_file_header(file.view(), name);
+                CHECK(header.letters == letters.size() && header.source_bytes == text.size() &&
+                      std::equal(counts, counts + 26, header.counts),
+                      what << ": header counts differ from the text's");
+
+                // The first and last letter, both sides of every checkpoint,
+                // and a few anywhere
+                LetterSource source = letter_source(header, index.view(), text, name);
+                std::set<uint64_t> checked;
+                if (!letters.empty()) checked = {0, letters.size() - 1};
+                for (uint64_t k = LETTER_INDEX_STRIDE; k < letters.size(); k += LETTER_INDEX_STRIDE) {
+                    checked.insert({k - 1, k});
+                }
+                for (int i = 0; i < 10 && !letters.empty(); i++) checked.insert(random_below(letters.size()));
+
+                for (uint64_t k : checked) {
+                    CHECK(source.offset(k) == positions[k],
+                          what << ": letter " << k << " at offset " << source.offset(k)
+                          << ", not " << positions[k]);
+                }
+                CHECK(source.offset(letters.size()) == text.size(),
+                      what << ": a letter past the end has an offset");
+            }
+        }
+    }
+
+    std::filesystem::remove(name);
+    std::filesystem::remove(name + ".idx");
+}
+
+
+// ============================================================================
+// COMPRESSION - Our Files Against the gzip and zstd Programs
+// ============================================================================
+// For every compression this build has: CompressedOutput's file must
+// read back through MappedInput and BlockReader, and decompress with the
+// real program; a file the program compressed must read back too.
+// The programs come from the command line (CMake finds them); without
+// one, only our own round trip is checked.
+
+void test_compression(Compression compression, const std::string& program) {
+    std::string suffix = compression == Compression::GZIP ? ".gz" : ".zst";
+    std::string name = compression_name(compression);
+
+    // Several blocks of BlockReader and COMPRESS_BUFFER, and an empty file
+    for (size_t length : {size_t(0), size_t(100), 3 * CHUNK_SIZE + 4321}) {
+        std::string text = random_bytes(length);
+        // Half letters, so the compressor has something to find
+        for (size_t i = 0; i < text.size(); i += 2) text[i] = 'E';
+
+        std::string ours = temp_name(suffix);
+        CompressedOutput out(ours, compression);
+        for (size_t i = 0; i < text.size(); i += 77777) {
+            out.write(std::span<const char>(text).subspan(i, std::min<size_t>(77777, text.size() - i)));
+        }
+        out.finish();
+
+        CHECK(file_compression(ours) == compression,
+              name << " output of " << length << " bytes isn't recognised as " << name);
+        CHECK(MappedInput(ours).view() == text,
+              name << " round trip of " << length << " bytes through MappedInput");
+
+        std::string blocks;
+        BlockReader reader(ours, CHUNK_SIZE);
+        for (std::span<char> block = reader.next(); !block.empty(); block = reader.next()) {
+            blocks.append(block.data(), block.size());
+        }
+        CHECK(blocks == text, name << " round trip of " << length << " bytes through BlockReader");
+
+        if (!program.empty()) {
+            // Their decoder on our file
+            std::string plain = temp_name(".plain");
+            std::string command = program + " -d -c < " + ours + " > " + plain;
+            CHECK(std::system(command.c_str()) == 0 && read_file_bytes(plain) == text,
+                  program << " -d of our " << length << "-byte file");
+
+            // Our decoder on theirs
+            std::ofstream(plain, std::ios::binary).write(text.data(), text.size());
+            std::string theirs = temp_name(".theirs" + suffix);
+            command = program + " -c < " + plain + " > " + theirs;
+            CHECK(std::system(command.c_str()) == 0 && MappedInput(theirs).view() == text,
+                  "reading " << program << "'s " << length << "-byte file");
+
+            std::filesystem::remove(plain);
+            std::filesystem::remove(theirs);
+        }
+        std::filesystem::remove(ours);
+    }
+}
+
+
+// ============================================================================
+// MAIN PROGRAM
+// ============================================================================
+
+int main(int argc, char* argv[]) {
+    // --gzip PROGRAM, --zstd PROGRAM: the programs to check our files against
+    std::string gzip_program, zstd_program;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--gzip") gzip_program = argv[i + 1];
+        if (arg == "--zstd") zstd_program = argv[i + 1];
+    }
+
+    test_kernels();
+    test_threads();
+    test_repeats();
+    test_columnar_ic();
+    test_variants();
+    test_letter_files();
+#ifdef CIPHER_HAVE_ZLIB
+    test_compression(Compression::GZIP, gzip_program);
+#endif
+#ifdef CIPHER_HAVE_ZSTD
+    test_compression(Compression::ZSTD, zstd_program);
+#endif
+    (void)gzip_program;
+    (void)zstd_program;
+
+    std::cout << checks - failures << " of " << checks << " checks passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -1,40 +1,19 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
-#include <cctype>
+#include <string_view>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include "analysis_state.h"
+#include "cipher.h"
+#include "cipher_io.h"
+#include "letter_file.h"
 
-std::string read_from_stdin() {
-    std::stringstream buffer;
-    buffer << std::cin.rdbuf();
-    return buffer.str();
-}
-
-std::string read_from_file(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
-        exit(1);
-    }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-
-void analyze_frequency(const std::string& text) {
-    int counts[26] = {0};
-    int total_letters = 0;
-    
-    // Count each letter
-    for (char c : text) {
-        if (std::isalpha(c)) {
-            c = std::toupper(c);
-            counts[c - 'A']++;
-            total_letters++;
-        }
-    }
+// Prints the frequency table for a set of letter counts
+void print_frequencies(const uint64_t counts[26]) {
+    uint64_t total_letters = 0;
+    for (int i = 0; i < 26; i++) total_letters += counts[i];
     
     if (total_letters == 0) {
         std::cout << "No letters found in input." << std::endl;
@@ -54,18 +33,292 @@ void analyze_frequency(const std::string& text) {
     }
 }
 
+// Counts directly over the input bytes - for files these are the
+// memory-mapped pages, so nothing is copied first
+// With several threads, each one counts (and pages in) its own slice
+void analyze_frequency(std::string_view text, unsigned threads) {
+    TaskPool pool(threads - 1);  // The calling thread helps out
+    uint64_t counts[26];
+    count_letters_parallel(text, counts, &pool);
+    print_frequencies(counts);
+}
+
+// --state FILE: only the bytes appended since the last run are counted,
+// then the table is printed from the running totals
+// stdin has no history to compare against, so all of it is new
+void analyze_incremental(std::string_view text, const std::string& state_file,
+                         bool is_file, const std::string& name) {
+    AnalysisState state;
+    state.load(state_file);
+
+    std::span<const char> added = is_file ? state.new_bytes(text, name)
+                                          : std::span<const char>(text.data(), text.size());
+    state.update(added);
+    state.save(state_file);
+
+    std::cout << "State " << state_file << ": " << added.size() << " new bytes, "
+              << state.bytes() << " bytes total\n\n";
+    print_frequencies(state.letter_counts());
+}
+
+// Counts every N-gram of the letters into a flat array of 26^N counters,
+// skipping non-letters in between - "TH E" counts TH, HE and THE
+// Each N-gram packs into a base-26 code that rolls along the text: drop
+// the oldest letter, append the new one. N is a template parameter so
+// the modulo is by a constant (a multiply, not a division)
+template <int N>
+uint64_t count_ngrams(std::string_view text, std::vector<uint64_t>& counts) {
+    constexpr uint32_t SLOTS = N == 2 ? 26 * 26 : 26 * 26 * 26;
+    counts.assign(SLOTS, 0);
+
+    const uint8_t* bin = LETTER_BINS.bin;
+    uint32_t code = 0;
+    uint64_t letters = 0;
+
+    for (char c : text) {
+        uint8_t pos = bin[static_cast<uint8_t>(c)];
+        if (pos == 26) continue;
+
+        code = (code % (SLOTS / 26)) * 26 + pos;
+        if (++letters >= N) counts[code]++;
+    }
+
+    return letters >= N ? letters - (N - 1) : 0;
+}
+
+// Bigram (n = 2) or trigram (n = 3) table, most common first
+void analyze_ngrams(std::string_view text, int n, size_t top) {
+    std::vector<uint64_t> counts;
+    uint64_t total = n == 2 ? count_ngrams<2>(text, counts) : count_ngrams<3>(text, counts);
+    uint32_t slots = static_cast<uint32_t>(counts.size());
+
+    const char* name = n == 2 ? "Bigram" : "Trigram";
+    const char* plural = n == 2 ? "bigrams" : "trigrams";
+    if (total == 0) {
+        std::cout << "No " << plural << " found in input." << std::endl;
+        return;
+    }
+
+    // Most common first (ties alphabetical)
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < slots; i++) {
+        if (counts[i] > 0) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return counts[a] > counts[b];
+    });
+    if (order.size() > top) order.resize(top);
+
+    std::cout << name << " frequencies (total " << plural << ": "
+              << total << ", top " << order.size() << "):\n\n";
+    for (uint32_t code : order) {
+        std::string gram(n, 'A');
+        for (int k = n - 1, rest = code; k >= 0; k--, rest /= 26) gram[k] = 'A' + rest % 26;
+
+        double percentage = (counts[code] * 100.0) / total;
+        std::cout << gram << ": " << std::setw(6) << std::fixed
+                  << std::setprecision(2) << percentage << "% ("
+                  << counts[code] << ")" << std::endl;
+    }
+}
+
+// Letter counts and IC of `window` bytes at a time, every `step` bytes
+// English text has IC ≈ 0.067, random letters ≈ 0.038 - so a jump in IC
+// (or in the top letters) shows where the encryption changes
+//
+// Sliding the window by one step adds the bytes that enter and removes
+// the bytes that leave, and Σ count*(count-1) is kept up to date as each
+// count changes. Every byte is added once and removed once, so the cost
+// is O(n) however large the window is.
+void analyze_windows(std::string_view text, size_t window, size_t step) {
+    const uint8_t* bin = LETTER_BINS.bin;
+    uint64_t counts[27] = {0};  // Bin 26 collects the non-letters
+    uint64_t pairs = 0;         // Σ count * (count - 1) over the letters
+
+    // Adding one more x raises x's term by 2 * count[x], removing lowers it
+    auto add = [&](char c) {
+        uint8_t pos = bin[static_cast<uint8_t>(c)];
+        if (pos < 26) pairs += 2 * counts[pos];
+        counts[pos]++;
+    };
+    auto remove = [&](char c) {
+        uint8_t pos = bin[static_cast<uint8_t>(c)];
+        counts[pos]--;
+        if (pos < 26) pairs -= 2 * counts[pos];
+    };
+
+    std::cout << "Window profile (window " << window << " bytes, step " << step << "):\n\n";
+    std::cout << std::setw(14) << "Offset" << std::setw(14) << "Letters"
+              << std::setw(9) << "IC" << "   Top letters\n";
+
+    size_t low = 0, high = 0;  // Bytes currently counted: [low, high)
+
+    for (size_t begin = 0; ; begin += step) {
+        size_t end = std::min(text.size(), begin + window);
+
+        // Slide: drop what's before this window, add what's new in it
+        // (a step larger than the window skips the gap between them)
+        while (low < begin && low < high) remove(text[low++]);
+        low = std::max(low, begin);
+        high = std::max(high, low);
+        while (high < end) add(text[high++]);
+
+        uint64_t letters = 0;
+        for (int i = 0; i < 26; i++) letters += counts[i];
+        double ic = letters > 1 ? static_cast<double>(pairs) / (letters * (letters - 1)) : 0.0;
+
+        // Top three letters of this window
+        int top[3] = {-1, -1, -1};
+        for (int i = 0; i < 26; i++) {
+            if (counts[i] == 0) continue;
+            for (int k = 0; k < 3; k++) {
+                if (top[k] < 0 || counts[i] > counts[top[k]]) {
+                    for (int m = 2; m > k; m--) top[m] = top[m - 1];
+                    top[k] = i;
+                    break;
+                }
+            }
+        }
+
+        std::cout << std::setw(14) << begin << std::setw(14) << letters
+                  << std::setw(9) << std::fixed << std::setprecision(4) << ic << "  ";
+        for (int k = 0; k < 3 && top[k] >= 0; k++) std::cout << ' ' << char('A' + top[k]);
+        std::cout << "\n";
+
+        if (end == text.size()) break;
+    }
+    std::cout.flush();
+}
+
+// What to report
+struct Options {
+    std::string filename;  // None = stdin
+    unsigned threads = 1;  // --threads N
+    int ngrams = 1;        // --ngrams 2|3: bigram or trigram table instead of letters
+    size_t top = 20;       // --top K: rows of the n-gram table
+    size_t window = 0;     // --window SIZE: profile per window instead of whole input
+    size_t step = 0;       // --step SIZE: distance between windows (default: window)
+    std::string state;     // --state FILE: keep running totals, count only new bytes
+};
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [filename] [--threads N]\n"
+              << "       " << program << " [filename] --ngrams 2|3 [--top K]\n"
+              << "       " << program << " [filename] --window SIZE [--step SIZE]"
+              << "   (SIZE like 65536, 64K, 1M)\n"
+              << "       " << program << " [filename] --state FILE" << std::endl;
+}
+
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--threads" && has_value) {
+            options.threads = parse_int_flag(arg, argv[++i], 1, 1024);
+        } else if (arg == "--ngrams" && has_value) {
+            options.ngrams = parse_int_flag(arg, argv[++i], 2, 3);
+        } else if (arg == "--top" && has_value) {
+            // There are no more rows than trigrams
+            options.top = parse_int_flag(arg, argv[++i], 1, 26 * 26 * 26);
+        } else if (arg == "--window" && has_value) {
+            options.window = parse_size(arg, argv[++i]);
+        } else if (arg == "--step" && has_value) {
+            options.step = parse_size(arg, argv[++i]);
+        } else if (arg == "--state" && has_value) {
+            options.state = argv[++i];
+        } else if (options.filename.empty() && arg.rfind("--", 0) != 0) {
+            options.filename = arg;
+        } else {
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    // --step only moves a --window along
+    if (options.step > 0 && options.window == 0) {
+        std::cerr << "Error: --step needs --window" << std::endl;
+        exit(1);
+    }
+    if (options.step == 0) options.step = options.window;
+
+    // The state only holds letter counts, not n-grams or windows
+    if (!options.state.empty() && (options.window > 0 || options.ngrams > 1)) {
+        std::cerr << "Error: --state only works with the letter table" << std::endl;
+        exit(1);
+    }
+    return options;
+}
+
+// Letter files (letter_file.h) carry their letter counts in the header,
+// so the letter table needs no pass over the data at all
+
+void analyze_letter_file(std::string_view data, const Options& options) {
+    std::string name = options.filename.empty() ? "stdin" : options.filename;
+    if (!options.state.empty() || options.window > 0) {
+        std::cerr << "Error: --state and --window need the original text, not a letter file"
+                  << std::endl;
+        exit(1);
+    }
+
+    if (options.ngrams > 1) {
+        analyze_ngrams(decode_letter_file(data, name), options.ngrams, options.top);
+    } else {
+        print_frequencies(letter_file_header(data, name).counts);
+    }
+}
+
+void analyze(std::string_view text, const Options& options) {
+    if (is_letter_file(text)) {
+        analyze_letter_file(text, options);
+    } else if (!options.state.empty()) {
+        analyze_incremental(text, options.state, !options.filename.empty(), options.filename);
+    } else if (options.window > 0) {
+        analyze_windows(text, options.window, options.step);
+    } else if (options.ngrams > 1) {
+        analyze_ngrams(text, options.ngrams, options.top);
+    } else {
+        analyze_frequency(text, options.threads);
+    }
+}
+
+// Whether a compressed file holds a letter file (only the header is
+// decompressed to find out)
+bool compressed_letter_file(const std::string& filename) {
+    MappedInput input(filename, false);
+    Compression compression = detect_compression(input.view());
+    require_compression(compression, filename);
+
+    Decompressor decompressor(input.view(), compression);
+    char header[sizeof(LetterFileHeader)];
+    size_t length = decompressor.read(header);
+    return is_letter_file(std::string_view(header, length));
+}
+
 int main(int argc, char* argv[]) {
-    std::string text;
-    
-    if (argc > 1) {
-        // Read from file
-        text = read_from_file(argv[1]);
+    Options options = parse_options(argc, argv);
+
+    // A compressed file in the default mode is counted as it is
+    // decompressed, never all in memory at once - unless it is a
+    // compressed letter file, which analyze() reads from its header
+    bool plain_count = options.state.empty() && options.window == 0 && options.ngrams <= 1;
+    if (!options.filename.empty() && plain_count &&
+        file_compression(options.filename) != Compression::NONE &&
+        !compressed_letter_file(options.filename)) {
+        uint64_t counts[26];
+        count_file_letters(options.filename, counts, options.threads);
+        print_frequencies(counts);
+    } else if (!options.filename.empty()) {
+        // Map the file
+        MappedInput input(options.filename);
+        analyze(input.view(), options);
     } else {
         // Read from stdin
-        text = read_from_stdin();
+        MappedInput input;
+        analyze(input.view(), options);
     }
     
-    analyze_frequency(text);
-    
     return 0;
 }
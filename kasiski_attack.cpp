@@ -3,567 +3,587 @@
 // ============================================================================
 // This program demonstrates how to break a Vigenère cipher using:
 // 1. Kasiski Method - finding repeated sequences to determine key length
-// 2. Index of Coincidence - statistical method to confirm key length
+// 2. Autocorrelation and Index of Coincidence - finding and confirming key length
 // 3. Frequency Analysis - analyzing each column to recover the key
 //
 // The Vigenère cipher was considered unbreakable for 300 years until
 // Kasiski published this method in 1863.
+//
+// The attack itself is in kasiski.h; this file is the command line
+// around it (prompts, batch and incremental modes).
 // ============================================================================
 
+// A stats build counts allocations with the operator new in kasiski_stats.h
+#ifdef KASISKI_STATS
+#define KASISKI_COUNT_ALLOCATIONS_HERE
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iomanip>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
 #include <string>
 #include <vector>
-#include <map>
-#include <algorithm>
-#include <iomanip>
-#include <cmath>
+#include "analysis_state.h"
+#include "arena.h"
+#include "cipher.h"
+#include "cipher_io.h"
+#include "kasiski.h"
+#include "kasiski_stats.h"
+#include "letter_file.h"
+#include "quadgram.h"
+#include "task_pool.h"
 
 
 // ============================================================================
-// UTILITY FUNCTIONS
+// BATCH OUTPUT - One JSON Line per Message
 // ============================================================================
+// crack_message and the rest of the attack live in kasiski.h
 
-// Reads entire file into a string
-// Same pattern as your other cipher programs
 
-std::string read_file(const std::string& filename) {
-    std::ifstream file(filename);
+// Prints one result as a JSON line (crack_result_json), e.g.
+// {"source":"msg1.txt","letters":311,"variant":"vigenere","key_length":6,"key":"CRYPTO",
+//  "score":-12.3456,"plaintext":"..."}
 
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
-        exit(1);
-    }
+void print_result_json(const std::string& source, size_t letters, const CrackResult& result) {
+    std::cout << crack_result_json(source, letters, result) << "\n";
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    // Downstream tools see each result as soon as it's ready
+    std::cout.flush();
 }
 
 
-// Removes all non-alphabetic characters and converts to uppercase
-// Ciphertext should be clean for analysis
-
-std::string clean_text(const std::string& text) {
-    std::string result;
-
-    for (char c : text) {
-        if (std::isalpha(c)) {
-            result += std::toupper(c);
-        }
-    }
-
-    return result;
-}
+// One message moving through the batch pipeline
 
+struct BatchJob {
+    std::string source;
+    std::string ciphertext;
+    CrackResult result;
+    std::atomic<bool> done{false};
+};
 
-// Calculate Greatest Common Divisor using Euclidean algorithm
-// Used to find common factors among distances
-// Example: gcd(12, 18) = 6
 
-int gcd(int a, int b) {
-    // Euclidean algorithm: gcd(a,b) = gcd(b, a mod b)
-    // Keep dividing until remainder is 0
+// Batch mode: crack every file given, or every line of stdin if none
+// Each stdin line is one message
+//
+// With a thread pool, every message becomes a task (and splits itself
+// further inside crack_message). Results are printed in input order as
+// soon as each one and everything before it is finished. At most
+// `max_in_flight` messages are read ahead, so a fast reader can't fill
+// memory while the workers are busy.
+
+int run_batch(const std::vector<std::string>& files, const CrackSettings& settings) {
+    TaskPool* pool = settings.pool;
+    size_t max_in_flight = pool != nullptr ? 4 * (pool->size() + 1) : 1;
+    std::deque<std::unique_ptr<BatchJob>> in_flight;
+
+    // Prints finished jobs from the front; with wait, blocks for the first one
+    auto print_finished = [&](bool wait) {
+        while (!in_flight.empty()) {
+            BatchJob& job = *in_flight.front();
+            if (!job.done) {
+                if (!wait) return;
+                pool->wait_until([&]() { return job.done.load(); });
+            }
+            print_result_json(job.source, job.ciphertext.length(), job.result);
+            in_flight.pop_front();
+            wait = false;
+        }
+    };
+
+    auto start_job = [&](std::string source, std::string ciphertext) {
+        auto job = std::make_unique<BatchJob>();
+        job->source = std::move(source);
+        job->ciphertext = std::move(ciphertext);
+
+        // Each message's scratch memory is one arena, rewound after it
+        if (pool == nullptr) {
+            ArenaScope scope;
+            job->result = crack_message(job->ciphertext, settings);
+            print_result_json(job->source, job->ciphertext.length(), job->result);
+            return;
+        }
 
-    while (b != 0) {
-        int temp = b;
-        b = a % b;
-        a = temp;
+        // Backpressure: wait for the oldest message before reading more
+        while (in_flight.size() >= max_in_flight) print_finished(true);
+
+        BatchJob* raw = job.get();
+        in_flight.push_back(std::move(job));
+        pool->submit([raw, &settings]() {
+            ArenaScope scope;
+            raw->result = crack_message(raw->ciphertext, settings);
+            raw->done = true;
+        });
+
+        print_finished(false);
+    };
+
+    if (files.empty()) {
+        std::string line;
+        size_t line_number = 0;
+
+        auto next_line = [&]() {
+            KASISKI_PHASE("read_input");
+            if (!std::getline(std::cin, line)) return false;
+            KASISKI_COUNT(BYTES_READ, line.size() + 1);
+            return true;
+        };
+
+        while (next_line()) {
+            line_number++;
+            std::string ciphertext = clean_text(line);
+            if (ciphertext.empty()) continue;
+
+            start_job("stdin:" + std::to_string(line_number), std::move(ciphertext));
+        }
+    } else {
+        for (const std::string& filename : files) {
+            std::string ciphertext;
+            {
+                KASISKI_PHASE("read_input");
+                MappedInput input(filename);
+                KASISKI_COUNT(BYTES_READ, input.size());
+                ciphertext = ciphertext_from(input.view(), filename);
+            }
+            start_job(filename, std::move(ciphertext));
+        }
     }
 
-    return a;
-}
-
-
-// Calculate GCD of a vector of numbers
-// Finds the largest number that divides all distances
+    while (!in_flight.empty()) print_finished(true);
 
-int gcd_of_vector(const std::vector<int>& numbers) {
-    if (numbers.empty()) return 1;
-
-    int result = numbers[0];
-
-    for (size_t i = 1; i < numbers.size(); i++) {
-        result = gcd(result, numbers[i]);
-    }
-
-    return result;
+    return 0;
 }
 
 
 // ============================================================================
-// KASISKI METHOD - Finding Repeated Sequences
+// INCREMENTAL MODE - Captures That Keep Growing
 // ============================================================================
-
-// Structure to hold information about repeated sequences
-
-struct Repetition {
-    std::string sequence;           // The repeated n-gram (e.g., "PTR")
-    std::vector<int> positions;     // Where it appears in ciphertext
-    std::vector<int> distances;     // Distances between occurrences
-};
-
-
-// Find all repeated n-grams of a given length
-// n = 3 for trigrams, n = 4 for tetragrams
-// Returns a map: sequence -> positions where it appears
-
-std::map<std::string, std::vector<int>> find_repeated_sequences(
-    const std::string& text,
-    int n
-) {
-    std::map<std::string, std::vector<int>> sequences;
-
-    // Extract all n-grams and record their positions
-    // Example: "HELLO" with n=3 gives "HEL" at 0, "ELL" at 1, "LLO" at 2
-
-    for (size_t i = 0; i <= text.length() - n; i++) {
-        std::string ngram = text.substr(i, n);
-        sequences[ngram].push_back(i);
+// With --state FILE the analysis runs on running totals (analysis_state.h)
+// instead of the ciphertext itself. Each run adds only the bytes appended
+// since the last one, then reports from the totals:
+//   - the factor histogram, from consecutive repeats of every trigram and
+//     tetragram (no pairwise distances or long repeats - those would need
+//     the whole text)
+//   - the IC table, folded from the saved column counts
+//   - a key for the best length, from the same column counts
+// The plaintext isn't printed: decrypting it would mean reading it all.
+
+int run_incremental(const std::string& state_file, const std::vector<std::string>& files,
+                    int max_key_len, ShiftScore scoring) {
+    AnalysisState state(max_key_len);
+    if (state.load(state_file) && state.max_key_len() != max_key_len) {
+        std::cout << "Note: " << state_file << " tracks key lengths up to "
+                  << state.max_key_len() << ", using that instead of --max-key\n";
+        max_key_len = state.max_key_len();
     }
 
-
-    // Remove sequences that only appear once (not repeated)
-    // We only care about repetitions!
-
-    auto it = sequences.begin();
-    while (it != sequences.end()) {
-        if (it->second.size() < 2) {
-            it = sequences.erase(it);  // Remove non-repeated sequences
+    // stdin has no history to compare against, so all of it is new
+    size_t added = 0;
+    {
+        KASISKI_PHASE("update_state");
+        if (!files.empty()) {
+            MappedInput input(files[0]);
+            if (is_letter_file(input.view())) {
+                std::cerr << "Error: --state needs the original text, not a letter file" << std::endl;
+                exit(1);
+            }
+            std::span<const char> appended = state.new_bytes(input.view(), files[0]);
+            state.update(appended);
+            added = appended.size();
         } else {
-            ++it;
+            MappedInput input;
+            state.update(std::span<const char>(input.data(), input.size()));
+            added = input.size();
         }
+        KASISKI_COUNT(BYTES_READ, added);
+        state.save(state_file);
     }
 
-    return sequences;
-}
-
-
-// Calculate distances between all pairs of repetitions
-// If a sequence appears at positions [5, 12, 33]:
-//   Distance 12-5 = 7
-//   Distance 33-5 = 28
-//   Distance 33-12 = 21
-
-std::vector<int> calculate_distances(const std::vector<int>& positions) {
-    std::vector<int> distances;
-
-    // For each pair of positions, calculate the distance
-    // Number of pairs = N*(N-1)/2
-
-    for (size_t i = 0; i < positions.size(); i++) {
-        for (size_t j = i + 1; j < positions.size(); j++) {
-            distances.push_back(positions[j] - positions[i]);
-        }
+    std::cout << "State " << state_file << ": " << added << " new bytes, "
+              << state.letters() << " letters total\n";
+    if (state.letters() == 0) return 0;
+
+    FactorHistogram histogram(max_key_len);
+    histogram.distances = state.distances();
+    histogram.gcd_all = static_cast<int>(state.gcd_all());
+    for (int f = 2; f <= max_key_len; f++) histogram.counts[f] = state.divisible_by(f);
+    print_factor_histogram(histogram);
+
+    int max_len = ic_table_limit(state.letters(), max_key_len);
+    std::vector<double> average_ic(max_len + 1, 0.0);
+    for (int len = 1; len <= max_len; len++) average_ic[len] = state.average_ic(len);
+    int key_length = print_ic_table(average_ic, max_len, max_key_len);
+
+    std::vector<uint64_t> counts = state.column_counts(key_length);
+    std::string key;
+    for (int col = 0; col < key_length; col++) {
+        key += static_cast<char>('A' + best_shift(counts.data() + col * 26, scoring));
     }
+    std::cout << "Most likely key: " << shortest_period(key) << "\n";
 
-    return distances;
+    return 0;
 }
 
 
-// Analyze repeated sequences using Kasiski method
-// Longer sequences (tetragrams) are more reliable than trigrams
-
-void kasiski_analysis(const std::string& ciphertext) {
-    std::cout << "\n========================================\n";
-    std::cout << "KASISKI METHOD - Repeated Sequences\n";
-    std::cout << "========================================\n\n";
-
-
-    // Look for tetragrams (4-letter sequences) - most reliable
-
-    std::cout << "Looking for repeated TETRAGRAMS (4 letters):\n";
-    std::cout << "--------------------------------------------\n";
-
-    auto tetragrams = find_repeated_sequences(ciphertext, 4);
+// ============================================================================
+// DICTIONARY MODE - Every Word of a Wordlist as the Key
+// ============================================================================
+// --dictionary WORDLIST tries each line of the wordlist as the key (see
+// dictionary_attack in kasiski.h), then prints how many keys were thrown
+// out at each stage, how fast, and the best keys found.
 
-    std::vector<int> all_distances_4;
+const size_t DICTIONARY_SHOWN = 10;  // Best keys listed
 
-    for (const auto& [seq, positions] : tetragrams) {
-        auto distances = calculate_distances(positions);
 
-        std::cout << "\"" << seq << "\" at positions: ";
-        for (int pos : positions) {
-            std::cout << pos << " ";
-        }
-        std::cout << " -> distances: ";
-        for (int dist : distances) {
-            std::cout << dist << " ";
-            all_distances_4.push_back(dist);
-        }
-        std::cout << "\n";
+int run_dictionary(const std::string& wordlist_file, const std::vector<std::string>& files,
+                   const QuadgramTable* quadgrams, TaskPool* pool) {
+    std::string ciphertext;
+    {
+        KASISKI_PHASE("read_input");
+        MappedInput input = files.empty() ? MappedInput() : MappedInput(files[0]);
+        KASISKI_COUNT(BYTES_READ, input.size());
+        ciphertext = ciphertext_from(input.view(), files.empty() ? "stdin" : files[0]);
     }
-
-
-    // Look for trigrams (3-letter sequences) - more common but less reliable
-
-    std::cout << "\nLooking for repeated TRIGRAMS (3 letters):\n";
-    std::cout << "-------------------------------------------\n";
-
-    auto trigrams = find_repeated_sequences(ciphertext, 3);
-
-    std::vector<int> all_distances_3;
-
-    // Limit output to avoid spam - only show first 10
-    int count = 0;
-    for (const auto& [seq, positions] : trigrams) {
-        if (count++ >= 10) {
-            std::cout << "... (showing first 10 trigrams)\n";
-            break;
-        }
-
-        auto distances = calculate_distances(positions);
-
-        std::cout << "\"" << seq << "\" at positions: ";
-        for (int pos : positions) {
-            std::cout << pos << " ";
-        }
-        std::cout << " -> distances: ";
-        for (int dist : distances) {
-            std::cout << dist << " ";
-            all_distances_3.push_back(dist);
-        }
-        std::cout << "\n";
+    if (ciphertext.empty()) {
+        std::cerr << "Error: the ciphertext has no letters" << std::endl;
+        return 1;
     }
 
+    MappedInput wordlist(wordlist_file);
+    KASISKI_COUNT(BYTES_READ, wordlist.size());
+    DictionaryReport report = dictionary_attack(ciphertext, wordlist.view(), quadgrams, pool);
 
-    // Analyze the distances to find likely key length
-
-    std::cout << "\nAnalyzing distances:\n";
-    std::cout << "--------------------\n";
-
-    if (!all_distances_4.empty()) {
-        int gcd_result = gcd_of_vector(all_distances_4);
-        std::cout << "GCD of tetragram distances: " << gcd_result << "\n";
+    std::cout << "========================================\n";
+    std::cout << "DICTIONARY ATTACK\n";
+    std::cout << "========================================\n\n";
+    std::cout << "Ciphertext length: " << ciphertext.length() << " letters\n";
+    std::cout << "Wordlist: " << wordlist_file << " (" << report.keys << " keys, "
+              << report.tested << " no longer than the ciphertext)\n\n";
+
+    double keys_per_second = report.seconds > 0 ? report.tested / report.seconds : 0.0;
+    std::cout << std::fixed << std::setprecision(3) << "Tested " << report.tested
+              << " keys in " << report.seconds << " s (" << std::setprecision(0)
+              << keys_per_second << " keys/sec)\n";
+    std::cout << "  Dropped by chi-squared before the last letter: " << report.chi_rejected
+              << "\n";
+    if (quadgrams != nullptr) {
+        std::cout << "  Decrypted and scored with quadgrams: " << report.quadgram_scored
+                  << " (" << report.quadgram_rejected << " dropped part way)\n";
     }
 
-    if (!all_distances_3.empty()) {
-        int gcd_result = gcd_of_vector(all_distances_3);
-        std::cout << "GCD of trigram distances: " << gcd_result << "\n";
+    if (report.candidates.empty()) {
+        std::cout << "\nNo key of the wordlist fits.\n";
+        return 0;
     }
 
-
-    // Count frequency of each distance to find common factors
-
-    std::map<int, int> distance_freq;
-    for (int d : all_distances_3) {
-        distance_freq[d]++;
-    }
-    for (int d : all_distances_4) {
-        distance_freq[d]++;
+    std::cout << "\nBest keys:\n";
+    std::cout << std::setw(6) << "Rank" << "  " << std::left << std::setw(20) << "Key"
+              << std::right << std::setw(12) << "Chi2/col";
+    if (quadgrams != nullptr) std::cout << std::setw(12) << "Fitness";
+    std::cout << "\n";
+
+    size_t shown = std::min(DICTIONARY_SHOWN, report.candidates.size());
+    for (size_t i = 0; i < shown; i++) {
+        const DictionaryCandidate& candidate = report.candidates[i];
+        std::cout << std::setw(6) << i + 1 << "  " << std::left << std::setw(20) << candidate.key
+                  << std::right << std::setw(12) << std::setprecision(2) << candidate.chi;
+        if (quadgrams != nullptr) {
+            std::cout << std::setw(12) << std::setprecision(3) << candidate.fitness
+                      << (candidate.rejected ? "  (dropped)" : "");
+        }
+        std::cout << "\n";
     }
 
-    std::cout << "\nMost common distances:\n";
-
-    // Convert map to vector for sorting
-    std::vector<std::pair<int, int>> sorted_distances(distance_freq.begin(), distance_freq.end());
-    std::sort(sorted_distances.begin(), sorted_distances.end(),
-              [](const auto& a, const auto& b) { return a.second > b.second; });
-
-    // Show top 10
-    for (size_t i = 0; i < std::min(size_t(10), sorted_distances.size()); i++) {
-        std::cout << "  Distance " << sorted_distances[i].first
-                  << " appears " << sorted_distances[i].second << " times\n";
+    const std::string& key = report.candidates[0].key;
+    if (report.candidates[0].rejected) {
+        std::cout << "\nNo key of the wordlist decrypts to English; the closest is "
+                  << key << "\n\n";
+    } else {
+        std::cout << "\nMost likely key: " << key << "\n\n";
     }
+    std::cout << "Decrypted text:\n";
+    print_plaintext(std::cout, DecryptView(ciphertext, key));
+    std::cout << "\n";
+    return 0;
 }
 
 
 // ============================================================================
-// INDEX OF COINCIDENCE - Statistical Analysis
+// STATS - Only With -DKASISKI_STATS
 // ============================================================================
+#ifdef KASISKI_STATS
 
-// Calculate Index of Coincidence for a string
-// IC measures how "non-random" text is
-//
-// For English text: IC ≈ 0.0667 (about 1/15)
-// For random text:  IC ≈ 0.0385 (about 1/26)
-//
-// Formula: IC = Σ(fi * (fi-1)) / (N * (N-1))
-// where fi = frequency of letter i, N = total letters
-
-double calculate_ic(const std::string& text) {
-    if (text.length() < 2) return 0.0;
+// Reports the stats when main returns, whichever way it returns
 
+struct StatsReport {
+    bool summary;            // --stats
+    std::string trace_file;  // --trace FILE
 
-    // Count letter frequencies (same pattern as your freq_analysis.cpp)
-
-    int counts[26] = {0};
-    int total = 0;
-
-    for (char c : text) {
-        if (std::isalpha(c)) {
-            counts[std::toupper(c) - 'A']++;
-            total++;
+    ~StatsReport() {
+        if (summary) Stats::get().print_summary(std::cerr);
+        if (!trace_file.empty() && !Stats::get().write_trace(trace_file)) {
+            std::cerr << "Error: Could not write to file " << trace_file << std::endl;
         }
     }
+};
 
-
-    // Calculate IC using the formula
-    // We're calculating: probability that two random letters are the same
-
-    double sum = 0.0;
-    for (int i = 0; i < 26; i++) {
-        // For each letter, how many ways can we pick 2 of them?
-        // That's fi * (fi - 1), or "fi choose 2"
-        sum += counts[i] * (counts[i] - 1);
-    }
-
-
-    // Total ways to pick 2 letters from N letters is N * (N-1)
-
-    double ic = sum / (total * (total - 1));
-
-    return ic;
-}
-
-
-// Test different key lengths using Index of Coincidence
-// The correct key length will show IC ≈ 0.067 (English-like)
-// Wrong key lengths will show IC ≈ 0.038 (random)
-
-void test_key_lengths_ic(const std::string& ciphertext, int max_length) {
-    std::cout << "\n========================================\n";
-    std::cout << "INDEX OF COINCIDENCE - Key Length Test\n";
-    std::cout << "========================================\n\n";
-
-    std::cout << "Testing key lengths 1-" << max_length << ":\n";
-    std::cout << "(English text IC ≈ 0.067, random text IC ≈ 0.038)\n\n";
-
-    std::vector<std::pair<int, double>> ic_scores;
-
-    for (int key_len = 1; key_len <= max_length; key_len++) {
-
-        // Split ciphertext into columns based on this key length
-        // This is the "columnar organization" you mentioned!
-
-        std::vector<std::string> columns(key_len);
-
-        for (size_t i = 0; i < ciphertext.length(); i++) {
-            columns[i % key_len] += ciphertext[i];  // Same modulo as vigenere!
-        }
-
-
-        // Calculate average IC across all columns
-        // If key_len is correct, each column is a Caesar cipher (English-like)
-        // If key_len is wrong, columns are mixed up (random-like)
-
-        double total_ic = 0.0;
-
-        for (int i = 0; i < key_len; i++) {
-            total_ic += calculate_ic(columns[i]);
-        }
-
-        double avg_ic = total_ic / key_len;
-        ic_scores.push_back({key_len, avg_ic});
-
-
-        // Print results with visual indicator
-
-        std::cout << "Key length " << std::setw(2) << key_len
-                  << ": IC = " << std::fixed << std::setprecision(4) << avg_ic;
-
-        if (avg_ic > 0.060) {
-            std::cout << " *** LIKELY ***";
-        }
-
-        std::cout << "\n";
-    }
-
-
-    // Find the best candidate
-
-    auto best = std::max_element(ic_scores.begin(), ic_scores.end(),
-                                  [](const auto& a, const auto& b) {
-                                      return a.second < b.second;
-                                  });
-
-    std::cout << "\nBest candidate: key length " << best->first
-              << " with IC = " << best->second << "\n";
-}
+#endif  // KASISKI_STATS
 
 
 // ============================================================================
-// FREQUENCY ANALYSIS - Breaking Each Column
+// MAIN PROGRAM
 // ============================================================================
 
-// Expected letter frequencies in English (as percentages)
-// E is most common at 13%, Z is least common at 0.07%
-
-const double ENGLISH_FREQ[26] = {
-    8.2, 1.5, 2.8, 4.3, 13.0, 2.2, 2.0, 6.1, 7.0, 0.15, 0.77, 4.0, 2.4,
-    6.7, 7.5, 1.9, 0.095, 6.0, 6.3, 9.1, 2.8, 0.98, 2.4, 0.15, 2.0, 0.074
+// Command-line flags
+struct Options {
+    std::vector<std::string> files;  // Ciphertext files (none = built-in example / stdin)
+    bool factors = false;            // --factors: factor histogram instead of distance lists
+    bool batch = false;              // --batch: crack every input automatically, JSON output
+    CrackSettings crack;             // --max-key N, --top-k N, --scoring chi|corr|quad, --restarts N,
+                                     // --variants LIST
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());  // --threads N
+    std::string quadgram_file;       // --quadgrams FILE: table made by --train-quadgrams
+    std::string train_corpus;        // --train-quadgrams CORPUS OUT
+    std::string train_output;
+    std::string encode_input;        // --encode-letters TEXT OUT [--packed]
+    std::string encode_output;
+    bool packed = false;
+    std::string original_file;       // --original TEXT: the text a letter file was made from
+    std::string state_file;          // --state FILE: incremental analysis of a growing file
+    std::string wordlist_file;       // --dictionary WORDLIST: try every word as the key
+    bool stats = false;              // --stats: phase times and counters on stderr (KASISKI_STATS)
+    std::string trace_file;          // --trace FILE: Chrome trace of every phase (KASISKI_STATS)
 };
 
 
-// Calculate letter frequencies for a string
-// Returns array of percentages (0-100)
-
-void calculate_frequencies(const std::string& text, double freq[26]) {
-    int counts[26] = {0};
-    int total = 0;
-
-    for (char c : text) {
-        if (std::isalpha(c)) {
-            counts[std::toupper(c) - 'A']++;
-            total++;
-        }
-    }
+// Parses --variants (parse_variant_list)
 
-    for (int i = 0; i < 26; i++) {
-        freq[i] = total > 0 ? (counts[i] * 100.0) / total : 0.0;
+std::vector<CipherVariant> parse_variants(const std::string& list) {
+    std::vector<CipherVariant> variants;
+    if (!parse_variant_list(list, variants)) {
+        std::cerr << "Error: --variants takes 'all' or a list of vigenere, beaufort,"
+                  << " variant-beaufort and autokey" << std::endl;
+        exit(1);
     }
+    return variants;
 }
 
 
-// Calculate chi-squared statistic
-// Measures how well observed frequencies match expected frequencies
-// Lower chi-squared = better match to English
-
-double chi_squared(const double observed[26], const double expected[26]) {
-    double chi2 = 0.0;
-
-    for (int i = 0; i < 26; i++) {
-        if (expected[i] > 0) {
-            double diff = observed[i] - expected[i];
-            chi2 += (diff * diff) / expected[i];
-        }
-    }
-
-    return chi2;
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [ciphertext_file] [--max-key N] [--factors]"
+              << " [--scoring chi|corr|quad] [--quadgrams FILE] [--restarts N]\n"
+              << "       " << program << " --batch [files...] [--max-key N] [--top-k N]"
+              << " [--scoring chi|corr|quad] [--quadgrams FILE] [--restarts N] [--threads N]\n"
+              << "               [--variants all|vigenere,beaufort,variant-beaufort,autokey]\n"
+              << "       " << program << " [ciphertext_file] --state FILE [--max-key N]"
+              << " [--scoring chi|corr]\n"
+              << "       " << program << " [ciphertext_file] --dictionary WORDLIST"
+              << " [--quadgrams FILE] [--threads N]\n"
+              << "       " << program << " --train-quadgrams <corpus_file> <table_file>\n"
+              << "       " << program << " --encode-letters <text_file> <letter_file> [--packed]\n"
+              << "       " << program << " <letter_file> --original <text_file> [--max-key N] [--factors]\n"
+              << "       (built with KASISKI_STATS=ON, any mode also takes --stats and --trace FILE)\n"
+              << "       (with --batch and no files, each line of stdin is one message)" << std::endl;
 }
 
 
-// Try all 26 possible Caesar shifts on a string
-// Find the shift that makes the frequency distribution most English-like
-// This recovers one letter of the Vigenère key!
-
-char break_caesar_shift(const std::string& column) {
-    double best_chi2 = 999999.0;
-    char best_shift = 'A';
-
-
-    // Try each possible shift (0-25, or 'A'-'Z')
-
-    for (int shift = 0; shift < 26; shift++) {
-
-        // Decrypt this column with this shift
-        // (Reverse the Caesar cipher)
-
-        std::string decrypted;
-
-        for (char c : column) {
-            if (std::isalpha(c)) {
-                int pos = std::toupper(c) - 'A';
-                // Subtract the shift (with +26 to handle negatives)
-                pos = (pos - shift + 26) % 26;
-                decrypted += ('A' + pos);
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--max-key" && has_value) {
+            options.crack.max_key_len = parse_int_flag(arg, argv[++i], 2, 10000);
+        } else if (arg == "--top-k" && has_value) {
+            options.crack.top_k = parse_int_flag(arg, argv[++i], 1, 10000);
+        } else if (arg == "--threads" && has_value) {
+            options.threads = parse_int_flag(arg, argv[++i], 1, 1024);
+        } else if (arg == "--restarts" && has_value) {
+            options.crack.restarts = parse_int_flag(arg, argv[++i], 0, 100000);
+        } else if (arg == "--factors") {
+            options.factors = true;
+        } else if (arg == "--batch") {
+            options.batch = true;
+        } else if (arg == "--scoring" && has_value) {
+            std::string method = argv[++i];
+            if (method == "chi") {
+                options.crack.scoring = ShiftScore::CHI_SQUARED;
+            } else if (method == "corr") {
+                options.crack.scoring = ShiftScore::CORRELATION;
+            } else if (method == "quad") {
+                options.crack.scoring = ShiftScore::QUADGRAM;
+            } else {
+                std::cerr << "Error: --scoring must be 'chi', 'corr' or 'quad'" << std::endl;
+                exit(1);
             }
+        } else if (arg == "--variants" && has_value) {
+            options.crack.variants = parse_variants(argv[++i]);
+        } else if (arg == "--quadgrams" && has_value) {
+            options.quadgram_file = argv[++i];
+        } else if (arg == "--state" && has_value) {
+            options.state_file = argv[++i];
+        } else if (arg == "--dictionary" && has_value) {
+            options.wordlist_file = argv[++i];
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--trace" && has_value) {
+            options.trace_file = argv[++i];
+        } else if (arg == "--encode-letters" && i + 2 < argc) {
+            options.encode_input = argv[++i];
+            options.encode_output = argv[++i];
+        } else if (arg == "--packed") {
+            options.packed = true;
+        } else if (arg == "--original" && has_value) {
+            options.original_file = argv[++i];
+        } else if (arg == "--train-quadgrams" && i + 2 < argc) {
+            options.train_corpus = argv[++i];
+            options.train_output = argv[++i];
+        } else if (arg.rfind("--", 0) == 0) {
+            print_usage(argv[0]);
+            exit(1);
+        } else {
+            options.files.push_back(arg);
         }
+    }
 
+#ifndef KASISKI_STATS
+    if (options.stats || !options.trace_file.empty()) {
+        std::cerr << "Error: --stats and --trace need a build with cmake -DKASISKI_STATS=ON" << std::endl;
+        exit(1);
+    }
+#endif
 
-        // Calculate frequency distribution of decrypted text
-
-        double freq[26];
-        calculate_frequencies(decrypted, freq);
-
-
-        // Compare to English frequencies using chi-squared
-
-        double chi2 = chi_squared(freq, ENGLISH_FREQ);
-
+    // A state's size grows with the square of the key lengths it tracks
+    if (!options.state_file.empty() && options.crack.max_key_len > MAX_STATE_KEY) {
+        std::cerr << "Error: --max-key with --state must be at most " << MAX_STATE_KEY << std::endl;
+        exit(1);
+    }
 
-        // Keep track of best match
+    // Only batch mode takes more than one file
+    if (!options.batch && options.files.size() > 1) {
+        print_usage(argv[0]);
+        exit(1);
+    }
 
-        if (chi2 < best_chi2) {
-            best_chi2 = chi2;
-            best_shift = 'A' + shift;
-        }
+    // Offsets are only reported by the analysis of one file
+    if (!options.original_file.empty() &&
+        (options.files.empty() || options.batch || !options.state_file.empty() ||
+         !options.wordlist_file.empty())) {
+        std::cerr << "Error: --original needs a letter file and works only without --batch,"
+                  << " --state and --dictionary" << std::endl;
+        exit(1);
     }
 
-    return best_shift;
+    return options;
 }
 
 
-// ============================================================================
-// KEY RECOVERY - Putting It All Together
-// ============================================================================
+// --train-quadgrams: counts the quadgrams of a plain English corpus and
+// saves the table for --quadgrams (or for embedding at compile time)
 
-// Recover the Vigenère key using frequency analysis on each column
-
-std::string recover_key(const std::string& ciphertext, int key_length) {
-    std::cout << "\n========================================\n";
-    std::cout << "KEY RECOVERY - Frequency Analysis\n";
-    std::cout << "========================================\n\n";
+int train_quadgrams(const std::string& corpus_file, const std::string& table_file) {
+    MappedInput corpus(corpus_file);
+    QuadgramTable table = QuadgramTable::train(corpus.view());
 
-    std::cout << "Attempting to recover key of length " << key_length << "...\n\n";
+    if (!table.save(table_file)) {
+        std::cerr << "Error: Could not write to file " << table_file << std::endl;
+        return 1;
+    }
 
+    std::cout << "Trained quadgrams on " << corpus_file << " (" << corpus.size()
+              << " bytes), table written to " << table_file << "\n";
+    return 0;
+}
 
-    // Step 1: Separate ciphertext into columns
-    // This is the columnar organization technique!
 
-    std::vector<std::string> columns(key_length);
+// --encode-letters: cleans a text once into a letter file (letter_file.h)
+// that every later run loads without cleaning it again
 
-    for (size_t i = 0; i < ciphertext.length(); i++) {
-        columns[i % key_length] += ciphertext[i];
+int encode_letters(const std::string& text_file, const std::string& letter_file, bool packed) {
+    MappedInput text(text_file);
+    if (is_letter_file(text.view())) {
+        std::cerr << "Error: " << text_file << " is already a letter file" << std::endl;
+        return 1;
+    }
+    if (!write_letter_file(text.view(), letter_file, packed)) {
+        std::cerr << "Error: Could not write to file " << letter_file << std::endl;
+        return 1;
     }
 
+    MappedInput written(letter_file);
+    const LetterFileHeader& header = letter_file_header(written.view(), letter_file);
+    std::cout << "Encoded " << text_file << " (" << text.size() << " bytes, " << header.letters
+              << " letters) into " << letter_file << " (" << written.size() << " bytes, "
+              << (packed ? "5-bit packed" : "one byte per letter") << ") and "
+              << letter_file << ".idx\n";
+    return 0;
+}
 
-    // Step 2: Break each column as a Caesar cipher
-
-    std::string recovered_key;
-
-    for (int i = 0; i < key_length; i++) {
-        std::cout << "Column " << i << " (positions " << i << ", "
-                  << (i + key_length) << ", " << (i + 2*key_length)
-                  << ", ...) has " << columns[i].length() << " letters\n";
 
-        char key_letter = break_caesar_shift(columns[i]);
-        recovered_key += key_letter;
+// The quadgram table to use, best source first:
+// --quadgrams FILE, then a compiled-in table, then (only if --scoring quad
+// or --dictionary needs one) a weak table built from single-letter frequencies
 
-        std::cout << "  -> Key letter " << i << " is: " << key_letter << "\n\n";
+std::optional<QuadgramTable> load_quadgrams(const Options& options) {
+    bool wanted = options.crack.scoring == ShiftScore::QUADGRAM || !options.wordlist_file.empty();
+    if (options.quadgram_file.empty() && !QuadgramTable::has_embedded() && !wanted) {
+        return std::nullopt;
     }
 
-    std::cout << "Recovered key: " << recovered_key << "\n";
+    QuadgramTable table = QuadgramTable::from_letter_frequencies(ENGLISH_FREQ);
 
-    return recovered_key;
+    if (!options.quadgram_file.empty()) {
+        if (!table.load(options.quadgram_file)) exit(1);
+    } else if (!table.load_embedded()) {
+        std::cerr << "Warning: no quadgram table given (--quadgrams FILE), "
+                  << "using letter frequencies instead" << std::endl;
+    }
+    return table;
 }
 
 
-// ============================================================================
-// DECRYPTION - Using the Recovered Key
-// ============================================================================
-
-// Decrypt Vigenère cipher (same algorithm as your vigenere.cpp)
-
-std::string vigenere_decrypt(const std::string& text, const std::string& key) {
-    std::string result = text;
-    int key_pos = 0;
-
-    for (char& c : result) {
-        if (std::isalpha(c)) {
-            c = std::toupper(c);
+int main(int argc, char* argv[]) {
+    Options options = parse_options(argc, argv);
+#ifdef KASISKI_STATS
+    StatsReport report{options.stats, options.trace_file};
+#endif
 
-            char key_letter = std::toupper(key[key_pos % key.length()]);
-            int shift = key_letter - 'A';
+    if (!options.train_corpus.empty()) {
+        return train_quadgrams(options.train_corpus, options.train_output);
+    }
 
-            int pos = c - 'A';
-            pos = (pos - shift + 26) % 26;  // Subtract for decryption
-            c = pos + 'A';
+    if (!options.encode_input.empty()) {
+        return encode_letters(options.encode_input, options.encode_output, options.packed);
+    }
 
-            key_pos++;
-        }
+    if (!options.state_file.empty()) {
+        return run_incremental(options.state_file, options.files, options.crack.max_key_len,
+                               options.crack.scoring);
     }
 
-    return result;
-}
+    std::optional<QuadgramTable> quadgrams = load_quadgrams(options);
+    if (quadgrams) options.crack.quadgrams = &*quadgrams;
 
+    if (!options.wordlist_file.empty()) {
+        TaskPool pool(options.threads - 1);
+        return run_dictionary(options.wordlist_file, options.files, options.crack.quadgrams,
+                              options.threads > 1 ? &pool : nullptr);
+    }
 
-// ============================================================================
-// MAIN PROGRAM
-// ============================================================================
+    if (options.batch) {
+        // The calling thread helps out, so N threads = N - 1 workers
+        TaskPool pool(options.threads - 1);
+        if (options.threads > 1) options.crack.pool = &pool;
+        return run_batch(options.files, options.crack);
+    }
 
-int main(int argc, char* argv[]) {
     std::cout << "========================================\n";
     std::cout << "KASISKI ATTACK - Vigenère Cipher Breaker\n";
     std::cout << "========================================\n";
@@ -573,34 +593,68 @@ int main(int argc, char* argv[]) {
 
     std::string ciphertext;
 
-    if (argc > 1) {
-        ciphertext = read_file(argv[1]);
-        std::cout << "Loaded ciphertext from: " << argv[1] << "\n";
+    // --original: the letter file's index and original text stay mapped
+    // for the analysis to report offsets in
+    std::optional<MappedInput> original, index;
+    std::optional<LetterSource> source;
+
+    if (!options.files.empty()) {
+        KASISKI_PHASE("read_input");
+        const std::string& name = options.files[0];
+        MappedInput input(name);
+        KASISKI_COUNT(BYTES_READ, input.size());
+        ciphertext = ciphertext_from(input.view(), name);
+        std::cout << "Loaded ciphertext from: " << name
+                  << (is_letter_file(input.view()) ? " (letter file)" : "") << "\n";
+
+        if (!options.original_file.empty()) {
+            if (!is_letter_file(input.view())) {
+                std::cerr << "Error: --original needs a letter file, and " << name
+                          << " is not one" << std::endl;
+                return 1;
+            }
+            original.emplace(options.original_file);
+            index.emplace(name + ".idx");
+            source = letter_source(letter_file_header(input.view(), name), index->view(),
+                                   original->view(), name);
+            std::cout << "Positions are byte offsets in: " << options.original_file << "\n";
+        }
     } else {
         // Example ciphertext from the passage (key length 6)
         ciphertext = "ZVZPV TOGGE KHXSN LRYRP ZHZIO RZHZA ZCOAF PNOHF "
                      "VEYHC ILCVS MGRYR SYXYR YSIEK RGBYX YRRCR IIVYH "
                      "CIYBA GZSWE KDMIJ RTHVX ZIKG";
         std::cout << "Using example ciphertext from the passage.\n";
-    }
-
-
-    // Clean the ciphertext (remove spaces, convert to uppercase)
 
-    ciphertext = clean_text(ciphertext);
+        // Clean the ciphertext (remove spaces, convert to uppercase)
+        ciphertext = clean_text(ciphertext);
+    }
 
     std::cout << "Ciphertext length: " << ciphertext.length() << " letters\n";
     std::cout << "Ciphertext: " << ciphertext << "\n";
 
 
+    // The analysis below allocates its scratch from one arena (arena.h)
+    ArenaScope scope;
+
+
     // Step 1: Kasiski analysis - find repeated sequences
+    // --factors streams distances into a histogram instead of listing them
 
-    kasiski_analysis(ciphertext);
+    if (options.factors) {
+        kasiski_factor_analysis(ciphertext, options.crack.max_key_len);
+    } else {
+        kasiski_analysis(ciphertext, source ? &*source : nullptr);
+    }
 
 
-    // Step 2: Index of Coincidence - confirm key length
+    // Step 2: Autocorrelation finds the key length, Index of Coincidence confirms it
 
-    test_key_lengths_ic(ciphertext, 15);
+    {
+        TaskPool pool(options.threads - 1);
+        test_key_lengths_ic(ciphertext, options.crack.max_key_len,
+                            options.threads > 1 ? &pool : nullptr);
+    }
 
 
     // Step 3: Ask user for key length (or auto-detect)
@@ -612,7 +666,7 @@ int main(int argc, char* argv[]) {
     int key_length;
     std::cin >> key_length;
 
-    if (key_length <= 0 || key_length > 50) {
+    if (key_length <= 0 || key_length > static_cast<int>(ciphertext.length())) {
         std::cout << "Exiting.\n";
         return 0;
     }
@@ -620,7 +674,8 @@ int main(int argc, char* argv[]) {
 
     // Step 4: Recover the key using frequency analysis
 
-    std::string recovered_key = recover_key(ciphertext, key_length);
+    std::string recovered_key = recover_key(ciphertext, key_length, options.crack.scoring,
+                                            options.crack.quadgrams, options.crack.restarts);
 
 
     // Step 5: Decrypt using the recovered key
@@ -629,10 +684,13 @@ int main(int argc, char* argv[]) {
     std::cout << "DECRYPTION\n";
     std::cout << "========================================\n\n";
 
-    std::string plaintext = vigenere_decrypt(ciphertext, recovered_key);
-
+    // Printed a block at a time - the plaintext is never held in full
     std::cout << "Decrypted text:\n";
-    std::cout << plaintext << "\n\n";
+    {
+        KASISKI_PHASE("decrypt");
+        print_plaintext(std::cout, DecryptView(ciphertext, recovered_key));
+    }
+    std::cout << "\n\n";
 
 
     // Optional: Try manual key entry if automatic recovery failed
@@ -645,9 +703,9 @@ int main(int argc, char* argv[]) {
     std::getline(std::cin, manual_key);
 
     if (!manual_key.empty()) {
-        plaintext = vigenere_decrypt(ciphertext, manual_key);
         std::cout << "\nDecrypted with key \"" << manual_key << "\":\n";
-        std::cout << plaintext << "\n";
+        print_plaintext(std::cout, DecryptView(ciphertext, manual_key));
+        std::cout << "\n";
     }
 
     return 0;
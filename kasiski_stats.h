@@ -0,0 +1,293 @@
+// ============================================================================
+// KASISKI STATS - Where Does the Time Go?
+// ============================================================================
+// Opt-in instrumentation for kasiski.h and kasiski_attack.cpp:
+//
+//   KASISKI_PHASE("columnar_ic");            times the rest of the scope
+//   KASISKI_COUNT(DISTANCES, pairs.size());  adds to a counter
+//
+// Both compile to nothing unless the build is configured with
+//   cmake -S . -B build -DKASISKI_STATS=ON
+// so a normal build pays nothing - not even evaluating the arguments.
+//
+// With it, kasiski_attack takes --stats (a summary on stderr when it
+// exits) and --trace FILE (a Chrome trace: open it in chrome://tracing or
+// https://ui.perfetto.dev to see every phase on every thread).
+//
+// Phases are coarse (one per function call, not per letter), and counters
+// are added in bulk, so even an instrumented build runs close to full speed.
+//
+// Allocations are counted by replacing the global operator new, which a
+// program may only do once. The one program file that wants it defines
+// KASISKI_COUNT_ALLOCATIONS_HERE before its first #include; it then
+// reads allocation_count and allocated_bytes (and, with KASISKI_STATS,
+// the allocations counters).
+// ============================================================================
+
+#ifndef KASISKI_STATS_H
+#define KASISKI_STATS_H
+
+#ifdef KASISKI_STATS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Everything that gets counted
+enum class Counter {
+    BYTES_READ,           // Input bytes read from files or stdin
+    NGRAMS_INSERTED,      // N-grams counted by find_repeated_sequences
+    DISTANCES,            // Repeat distances generated
+    COLUMNS_SCORED,       // Columns whose 26 shifts were scored (best_shift)
+    FITNESS_EVALUATIONS,  // Quadgram column_fitness calls in hill climbing
+    MESSAGES_CRACKED,     // crack_message calls
+    ALLOCATIONS,          // operator new calls
+    ALLOCATED_BYTES,      // Bytes asked of operator new
+    COUNT
+};
+
+inline const char* counter_name(Counter counter) {
+    switch (counter) {
+        case Counter::BYTES_READ:          return "bytes_read";
+        case Counter::NGRAMS_INSERTED:     return "ngrams_inserted";
+        case Counter::DISTANCES:           return "distances";
+        case Counter::COLUMNS_SCORED:      return "columns_scored";
+        case Counter::FITNESS_EVALUATIONS: return "fitness_evaluations";
+        case Counter::MESSAGES_CRACKED:    return "messages_cracked";
+        case Counter::ALLOCATIONS:         return "allocations";
+        case Counter::ALLOCATED_BYTES:     return "allocated_bytes";
+        default:                           return "?";
+    }
+}
+
+
+// Counters are plain atomics, constant-initialized - so operator new can
+// count allocations even before main() runs
+inline std::atomic<uint64_t> stats_counters[static_cast<int>(Counter::COUNT)] = {};
+
+inline void stats_count(Counter counter, uint64_t amount) {
+    stats_counters[static_cast<int>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+
+// Most timed phases a trace keeps; after that they are only summed up
+const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+
+class Stats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Stats& get() {
+        static Stats stats;
+        return stats;
+    }
+
+
+    // Called when a phase ends
+    void record(const char* name, Clock::time_point start, Clock::time_point end) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        PhaseTotal& total = totals_[name];
+        total.calls++;
+        total.seconds += seconds;
+
+        if (events_.size() < MAX_TRACE_EVENTS) {
+            events_.push_back({name, start, end, thread_number()});
+        } else {
+            dropped_++;
+        }
+    }
+
+
+    // Phase totals (slowest first) and counters
+    void print_summary(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::vector<std::pair<std::string, PhaseTotal>> phases(totals_.begin(), totals_.end());
+        std::sort(phases.begin(), phases.end(), [](const auto& a, const auto& b) {
+            return a.second.seconds > b.second.seconds;
+        });
+
+        double wall = std::chrono::duration<double>(Clock::now() - started_).count();
+        out << "\n========================================\n";
+        out << "STATS (" << std::fixed << std::setprecision(3) << wall << " s wall time)\n";
+        out << "========================================\n\n";
+
+        out << std::left << std::setw(24) << "Phase" << std::right << std::setw(10) << "Calls"
+            << std::setw(12) << "Seconds" << std::setw(12) << "ms/call" << "\n";
+        for (const auto& [name, total] : phases) {
+            out << std::left << std::setw(24) << name << std::right << std::setw(10) << total.calls
+                << std::setw(12) << std::setprecision(4) << total.seconds
+                << std::setw(12) << std::setprecision(4) << total.seconds * 1e3 / total.calls
+                << "\n";
+        }
+        out << "(nested phases are included in their callers' time)\n\n";
+
+        for (int c = 0; c < static_cast<int>(Counter::COUNT); c++) {
+            out << std::left << std::setw(24) << counter_name(static_cast<Counter>(c))
+                << std::right << std::setw(16) << stats_counters[c].load() << "\n";
+        }
+        out << std::flush;
+    }
+
+
+    // Chrome trace event format: one "complete" event per phase, plus the
+    // counters as a final "C" event so they show up as a track too
+    bool write_trace(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ofstream out(filename);
+
+        auto micros = [&](Clock::time_point t) {
+            return std::chrono::duration<double, std::micro>(t - started_).count();
+        };
+
+        out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+        for (const Event& event : events_) {
+            double start = micros(event.start);
+            out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1"
+                << ",\"tid\":" << event.thread << ",\"ts\":" << start
+                << ",\"dur\":" << micros(event.end) - start << "},\n";
+        }
+
+        out << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":" << micros(Clock::now())
+            << ",\"args\":{";
+        for (int c = 0; c < static_cast<int>(Counter::COUNT); c++) {
+            out << (c > 0 ? "," : "") << "\"" << counter_name(static_cast<Counter>(c))
+                << "\":" << stats_counters[c].load();
+        }
+        out << "}}\n],\"otherData\":{\"dropped_events\":" << dropped_ << "}}\n";
+
+        return static_cast<bool>(out);
+    }
+
+private:
+    struct PhaseTotal {
+        uint64_t calls = 0;
+        double seconds = 0.0;
+    };
+
+    struct Event {
+        const char* name;
+        Clock::time_point start;
+        Clock::time_point end;
+        int thread;
+    };
+
+    Stats() : started_(Clock::now()) {}
+
+
+    // Small thread numbers for the trace, in order of first appearance
+    int thread_number() {
+        auto [it, added] = threads_.try_emplace(std::this_thread::get_id(),
+                                                static_cast<int>(threads_.size()) + 1);
+        return it->second;
+    }
+
+
+    std::mutex mutex_;
+    Clock::time_point started_;
+    std::map<std::string, PhaseTotal> totals_;
+    std::vector<Event> events_;
+    size_t dropped_ = 0;
+    std::map<std::thread::id, int> threads_;
+};
+
+
+// Times from construction to the end of the enclosing scope
+class PhaseTimer {
+public:
+    // Stats::get() first, so its clock starts before the first phase does
+    explicit PhaseTimer(const char* name) : name_(name) {
+        Stats::get();
+        start_ = Stats::Clock::now();
+    }
+    ~PhaseTimer() { Stats::get().record(name_, start_, Stats::Clock::now()); }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    const char* name_;
+    Stats::Clock::time_point start_;
+};
+
+
+#define KASISKI_STATS_CONCAT2(a, b) a##b
+#define KASISKI_STATS_CONCAT(a, b) KASISKI_STATS_CONCAT2(a, b)
+#define KASISKI_PHASE(name) PhaseTimer KASISKI_STATS_CONCAT(kasiski_phase_, __LINE__)(name)
+#define KASISKI_COUNT(counter, amount) stats_count(Counter::counter, (amount))
+
+#else
+
+#define KASISKI_PHASE(name) ((void)0)
+#define KASISKI_COUNT(counter, amount) ((void)0)
+
+#endif  // KASISKI_STATS
+
+
+// ============================================================================
+// ALLOCATION COUNTING - Only With KASISKI_COUNT_ALLOCATIONS_HERE
+// ============================================================================
+// Counts every allocation of the program - std::string, std::vector,
+// everything. new[] and delete[] forward to these by default.
+// The aligned forms are replaced too: std::pmr::new_delete_resource(),
+// which scratch() uses outside an ArenaScope and arena overflow goes to,
+// allocates with operator new(size, align_val_t).
+// noinline: inlined into the containers, GCC would pair malloc and free
+// itself and warn about mismatched new and delete
+
+#ifdef KASISKI_COUNT_ALLOCATIONS_HERE
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Constant-initialized, so allocations before main() are counted too
+std::atomic<uint64_t> allocation_count{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+inline void count_allocation(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    KASISKI_COUNT(ALLOCATIONS, 1);
+    KASISKI_COUNT(ALLOCATED_BYTES, size);
+}
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    count_allocation(size);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new(size_t size, std::align_val_t alignment) {
+    count_allocation(size);
+    size_t align = static_cast<size_t>(alignment);
+    size_t rounded = (std::max<size_t>(size, 1) + align - 1) / align * align;  // aligned_alloc wants a multiple
+    if (void* p = std::aligned_alloc(align, rounded)) return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+#endif  // KASISKI_COUNT_ALLOCATIONS_HERE
+
+#endif  // KASISKI_STATS_H
@@ -0,0 +1,202 @@
+// ============================================================================
+// QUADGRAM FITNESS - How English does a text look?
+// ============================================================================
+// Chi-squared compares single-letter frequencies, which says nothing about
+// letter ORDER: "EHT" scores exactly like "THE". Quadgram statistics score
+// every run of 4 letters instead:
+//
+//   fitness = Σ log10 P(quadgram)    e.g. P("TION") is high, P("QXZJ") is tiny
+//
+// The table holds one log-probability per possible quadgram: 26^4 = 456,976
+// floats ≈ 1.8 MB, small enough to stay in L2/L3 cache. A quadgram is looked
+// up by its base-26 code (same packing as find_repeated_sequences), which
+// rolls along the text: drop the oldest letter, shift, add the new one.
+//
+// Where the table comes from, best first:
+//   1. A binary file made by train() + save()           (--quadgrams FILE)
+//   2. Embedded at compile time with
+//        cmake -S . -B build -DQUADGRAM_EMBED_FILE=english.qgm
+//   3. Built from single-letter frequencies (letters treated as
+//      independent) - weak, but always available
+// ============================================================================
+
+#ifndef QUADGRAM_H
+#define QUADGRAM_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cipher_io.h"
+
+
+// Every table file starts with these 8 bytes, then 26^4 float32 values
+const char QUADGRAM_MAGIC[8] = {'Q', 'U', 'A', 'D', 'G', 'R', 'M', '1'};
+const uint32_t QUADGRAM_COUNT = 26 * 26 * 26 * 26;
+
+
+#ifdef QUADGRAM_EMBED_FILE
+// Pulls the table file into the program's read-only data at compile time
+__asm__(".section .rodata\n"
+        ".balign 16\n"
+        "quadgram_embedded_begin:\n"
+        ".incbin \"" QUADGRAM_EMBED_FILE "\"\n"
+        "quadgram_embedded_end:\n"
+        ".previous\n");
+extern const char quadgram_embedded_begin[] __asm__("quadgram_embedded_begin");
+extern const char quadgram_embedded_end[] __asm__("quadgram_embedded_end");
+#endif
+
+
+class QuadgramTable {
+public:
+    // Log-probabilities from single-letter frequencies (percentages)
+    // P(ABCD) = P(A) P(B) P(C) P(D) - the weakest source, used when no
+    // trained table is available
+    static QuadgramTable from_letter_frequencies(const double freq[26]) {
+        QuadgramTable table;
+        double log_freq[26];
+        for (int i = 0; i < 26; i++) log_freq[i] = std::log10(freq[i] / 100.0);
+
+        for (uint32_t code = 0; code < QUADGRAM_COUNT; code++) {
+            table.log_prob_[code] = static_cast<float>(
+                log_freq[code / 17576] + log_freq[code / 676 % 26] +
+                log_freq[code / 26 % 26] + log_freq[code % 26]);
+        }
+        table.source_ = "letter frequencies";
+        return table;
+    }
+
+
+    // Counts every quadgram of a training corpus (any text, cleaned here)
+    // Quadgrams never seen get a floor of 0.01 / total, so one odd
+    // quadgram can't make a score minus infinity
+    static QuadgramTable train(std::string_view corpus) {
+        std::vector<uint64_t> counts(QUADGRAM_COUNT, 0);
+        uint64_t total = 0;
+        uint32_t code = 0;
+        int letters = 0;
+
+        for (char c : corpus) {
+            uint8_t pos = static_cast<uint8_t>((c | 0x20) - 'a');
+            if (pos >= 26) continue;
+
+            code = (code % 17576) * 26 + pos;
+            if (++letters >= 4) {
+                counts[code]++;
+                total++;
+            }
+        }
+
+        QuadgramTable table;
+        double floor = std::log10(0.01 / std::max<uint64_t>(total, 1));
+        for (uint32_t i = 0; i < QUADGRAM_COUNT; i++) {
+            table.log_prob_[i] = counts[i] > 0
+                ? static_cast<float>(std::log10(static_cast<double>(counts[i]) / total))
+                : static_cast<float>(floor);
+        }
+        table.source_ = "trained";
+        return table;
+    }
+
+
+    // Loads a table written by save()
+    // Returns false (and leaves the table alone) if the file is wrong
+    bool load(const std::string& filename) {
+        MappedInput input(filename);
+        if (!load_bytes(input.data(), input.size())) {
+            std::cerr << "Error: " << filename << " is not a quadgram table" << std::endl;
+            return false;
+        }
+        source_ = filename;
+        return true;
+    }
+
+
+    // Whether a table was compiled in with QUADGRAM_EMBED_FILE
+    static bool has_embedded() {
+#ifdef QUADGRAM_EMBED_FILE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+
+    // The table compiled into the program, if there is one
+    bool load_embedded() {
+#ifdef QUADGRAM_EMBED_FILE
+        if (load_bytes(quadgram_embedded_begin, quadgram_embedded_end - quadgram_embedded_begin)) {
+            source_ = "embedded";
+            return true;
+        }
+#endif
+        return false;
+    }
+
+
+    bool save(const std::string& filename) const {
+        std::ofstream out(filename, std::ios::binary);
+        out.write(QUADGRAM_MAGIC, sizeof(QUADGRAM_MAGIC));
+        out.write(reinterpret_cast<const char*>(log_prob_.data()),
+                  log_prob_.size() * sizeof(float));
+        return static_cast<bool>(out);
+    }
+
+
+    // Log-probability of one quadgram by code
+    float operator[](uint32_t code) const { return log_prob_[code]; }
+
+
+    // Code of the quadgram starting at text (4 uppercase letters A-Z)
+    static uint32_t code_at(const char* text) {
+        return (text[0] - 'A') * 17576 + (text[1] - 'A') * 676 + (text[2] - 'A') * 26 + (text[3] - 'A');
+    }
+
+
+    // Total fitness of cleaned text (uppercase A-Z only)
+    double score(std::string_view text) const {
+        if (text.length() < 4) return 0.0;
+
+        const float* table = log_prob_.data();
+        uint32_t code = (text[0] - 'A') * 676 + (text[1] - 'A') * 26 + (text[2] - 'A');
+        double total = 0.0;
+
+        for (size_t i = 3; i < text.length(); i++) {
+            code = (code % 17576) * 26 + (text[i] - 'A');
+            total += table[code];
+        }
+        return total;
+    }
+
+
+    // Fitness per quadgram, so texts of different lengths compare fairly
+    double score_per_quadgram(std::string_view text) const {
+        return text.length() < 4 ? 0.0 : score(text) / (text.length() - 3);
+    }
+
+
+    const std::string& source() const { return source_; }
+
+private:
+    QuadgramTable() : log_prob_(QUADGRAM_COUNT, 0.0f) {}
+
+    bool load_bytes(const char* data, size_t size) {
+        size_t expected = sizeof(QUADGRAM_MAGIC) + QUADGRAM_COUNT * sizeof(float);
+        if (size != expected || std::memcmp(data, QUADGRAM_MAGIC, sizeof(QUADGRAM_MAGIC)) != 0) {
+            return false;
+        }
+        std::memcpy(log_prob_.data(), data + sizeof(QUADGRAM_MAGIC), QUADGRAM_COUNT * sizeof(float));
+        return true;
+    }
+
+    std::vector<float> log_prob_;
+    std::string source_;
+};
+
+#endif  // QUADGRAM_H
@@ -0,0 +1,547 @@
+// ============================================================================
+// SHIFT KERNEL - Vectorized letter shifting for Caesar and Vigenère
+// ============================================================================
+// Both ciphers do the same thing to every letter: uppercase it, add a
+// shift, wrap around at 26. Caesar uses one shift for the whole text,
+// Vigenère cycles through one shift per key letter. This header does that
+// work 16 or 32 bytes at a time using SIMD instructions:
+//
+//   AVX2   (x86, 32 bytes per step)  - picked at runtime if the CPU has it
+//   SSE4.2 (x86, 16 bytes per step)  - picked at runtime if the CPU has it
+//   NEON   (ARM64, 16 bytes per step) - always available on AArch64
+//   table  (one byte per step)       - everywhere else, and for the tail
+//
+// The tricks that make it vectorizable:
+// - Letter test without isalpha: (c | 0x20) - 'a' is 0..25 exactly for
+//   ASCII letters (the | 0x20 folds uppercase onto lowercase)
+// - Wrap without % 26: t = pos + shift is 0..50, and min(t, t - 26) picks
+//   the right one because t - 26 underflows to a huge byte when t < 26
+// - Vigenère key position only advances on letters, so each byte needs to
+//   know how many letters came before it in the block. A prefix sum over
+//   the letter mask gives that count, and a byte shuffle uses it to pick
+//   the shift out of a precomputed, repeated key schedule
+// - Kernels are templates, instantiated for Caesar (one shift: no prefix
+//   sum, no shuffle) and, in the scalar kernel, for every key length up
+//   to 16 (the key index wraps at a constant). The instantiation is picked
+//   once per call from the CPU and the key length. Direction needs no
+//   instantiation of its own: it is folded into the schedule.
+//
+// Behaviour matches the original loops exactly: ASCII letters come out
+// uppercase and shifted, every other byte is left unchanged.
+// ============================================================================
+
+#ifndef SHIFT_KERNEL_H
+#define SHIFT_KERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cctype>
+
+#include "task_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHIFT_KERNEL_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SHIFT_KERNEL_NEON 1
+#endif
+
+
+// Precomputed key schedule
+// shifts[i] is the shift (0-25, already adjusted for direction) applied
+// to the i-th letter. The key is repeated until the schedule is at least
+// 32 long (so one AVX2 step can never wrap more than once), then 32 extra
+// entries are added so a 16-byte load starting anywhere inside the
+// period never reads past the end.
+
+struct ShiftSchedule {
+    std::vector<uint8_t> shifts;
+    size_t key_length = 1;  // Length of the original key
+    size_t period = 1;      // Repeated length, a multiple of key_length >= 32
+    bool reflect = false;   // Beaufort: letters are negated (A→A, B→Z, C→Y, ...) first
+};
+
+
+// Builds a schedule from per-letter shifts (each 0-25)
+// direction: +1 for encryption, -1 for decryption
+// Decryption adds (26 - shift) so the kernels only ever need to add
+
+inline ShiftSchedule make_schedule(const std::vector<int>& key_shifts, int direction) {
+    ShiftSchedule schedule;
+    schedule.key_length = key_shifts.empty() ? 1 : key_shifts.size();
+
+    size_t repeats = (32 + schedule.key_length - 1) / schedule.key_length;
+    schedule.period = schedule.key_length * repeats;
+    schedule.shifts.resize(schedule.period + 32);
+
+    for (size_t i = 0; i < schedule.shifts.size(); i++) {
+        int shift = key_shifts.empty() ? 0 : key_shifts[i % schedule.key_length];
+        schedule.shifts[i] = static_cast<uint8_t>(((direction * shift) % 26 + 26) % 26);
+    }
+
+    return schedule;
+}
+
+
+// Schedule for a Vigenère keyword (letters only, any case)
+
+inline ShiftSchedule make_schedule(const std::string& key, int direction) {
+    std::vector<int> key_shifts;
+    for (char c : key) {
+        key_shifts.push_back(std::toupper(static_cast<unsigned char>(c)) - 'A');
+    }
+    return make_schedule(key_shifts, direction);
+}
+
+
+// Schedule for a Caesar shift (key of length 1)
+
+inline ShiftSchedule make_schedule(int shift) {
+    return make_schedule(std::vector<int>{((shift % 26) + 26) % 26}, 1);
+}
+
+
+// ============================================================================
+// SCALAR KERNEL - One byte at a time, by table lookup
+// ============================================================================
+// Everything the cipher does to one byte under one shift - letter test,
+// uppercase, add, wrap - fits in a 256-entry table: translate[s][c] is
+// byte c after shift s (non-letters map to themselves). All 26 tables
+// take 6.5 KB and are built at compile time, so a byte costs one load.
+
+struct TranslationTables {
+    uint8_t translate[26][256];
+    uint8_t is_letter[256];  // 1 for A-Z and a-z: how far the key advances
+    uint8_t reflect[256];    // Letter at position p → uppercase letter at (26 - p) % 26
+};
+
+
+constexpr TranslationTables make_translation_tables() {
+    TranslationTables tables{};
+
+    for (int c = 0; c < 256; c++) {
+        // Same letter test as the vector kernels
+        uint8_t pos = static_cast<uint8_t>((c | 0x20) - 'a');
+        tables.is_letter[c] = pos < 26;
+        tables.reflect[c] = pos < 26 ? static_cast<uint8_t>('A' + (26 - pos) % 26)
+                                     : static_cast<uint8_t>(c);
+
+        for (int shift = 0; shift < 26; shift++) {
+            tables.translate[shift][c] = pos < 26
+                ? static_cast<uint8_t>('A' + (pos + shift) % 26)
+                : static_cast<uint8_t>(c);
+        }
+    }
+
+    return tables;
+}
+
+
+inline constexpr TranslationTables TRANSLATION_TABLES = make_translation_tables();
+
+
+// General scalar kernel: any key length, rolling key index
+// Used for long keys and for the final bytes that don't fill a vector
+// phase: position in the schedule, 0 <= phase < period
+
+inline void shift_scalar(uint8_t* data, size_t length, const ShiftSchedule& schedule,
+                         size_t& phase) {
+    const uint8_t* shifts = schedule.shifts.data();
+    const TranslationTables& tables = TRANSLATION_TABLES;
+
+    // The table changes with the key letter, which only advances on
+    // letters (a compare and conditional move, no branches)
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = data[i];
+        data[i] = tables.translate[shifts[phase]][c];
+
+        phase += tables.is_letter[c];
+        phase = phase == schedule.period ? 0 : phase;
+    }
+}
+
+
+// Scalar kernel for a key of exactly KeyLength letters
+// The KeyLength tables in use are looked up once, before the loop, and
+// the key index wraps at a compile-time constant. The schedule repeats
+// every KeyLength entries, so returning the index within the key is as
+// good a phase as any.
+// KeyLength 1 is Caesar: one table for the whole buffer, a pure byte
+// translation.
+
+template <size_t KeyLength>
+inline void shift_scalar_fixed(uint8_t* data, size_t length, const ShiftSchedule& schedule,
+                               size_t& phase) {
+    const TranslationTables& tables = TRANSLATION_TABLES;
+
+    if constexpr (KeyLength == 1) {
+        const uint8_t* table = tables.translate[schedule.shifts[0]];
+        for (size_t i = 0; i < length; i++) data[i] = table[data[i]];
+        phase = 0;
+    } else {
+        const uint8_t* table[KeyLength];
+        for (size_t k = 0; k < KeyLength; k++) table[k] = tables.translate[schedule.shifts[k]];
+
+        size_t k = phase % KeyLength;
+        for (size_t i = 0; i < length; i++) {
+            uint8_t c = data[i];
+            data[i] = table[k][c];
+
+            k += tables.is_letter[c];
+            k = k == KeyLength ? 0 : k;
+        }
+        phase = k;
+    }
+}
+
+
+// ============================================================================
+// x86 KERNELS - SSE4.2 and AVX2
+// ============================================================================
+// Compiled with target attributes, so the file still builds without
+// -mavx2 and the fast paths are only entered if the CPU supports them.
+
+#ifdef SHIFT_KERNEL_X86
+
+// Caesar = true: every letter gets shifts[0], so the prefix sum and
+// shuffle are skipped and phase is left alone
+
+template <bool Caesar>
+__attribute__((target("sse4.2")))
+inline void shift_sse42(uint8_t* data, size_t length, const ShiftSchedule& schedule,
+                        size_t& phase) {
+    const uint8_t* shifts = schedule.shifts.data();
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i letter_a = _mm_set1_epi8('a');
+    const __m128i upper_a = _mm_set1_epi8('A');
+    const __m128i max_pos = _mm_set1_epi8(25);
+    const __m128i twenty_six = _mm_set1_epi8(26);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i caesar_shift = _mm_set1_epi8(static_cast<char>(shifts[0]));
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+        // Classify: pos is 0-25 for letters
+        __m128i pos = _mm_sub_epi8(_mm_or_si128(c, case_bit), letter_a);
+        __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(pos, max_pos), pos);
+
+        __m128i shift = caesar_shift;
+        if constexpr (!Caesar) {
+            // Count letters before each byte (exclusive prefix sum)
+            __m128i ones = _mm_and_si128(is_letter, one);
+            __m128i before = _mm_add_epi8(ones, _mm_slli_si128(ones, 1));
+            before = _mm_add_epi8(before, _mm_slli_si128(before, 2));
+            before = _mm_add_epi8(before, _mm_slli_si128(before, 4));
+            before = _mm_add_epi8(before, _mm_slli_si128(before, 8));
+            before = _mm_sub_epi8(before, ones);
+
+            // Pick each letter's shift from the schedule
+            __m128i window = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shifts + phase));
+            shift = _mm_shuffle_epi8(window, before);
+        }
+
+        // Add and wrap
+        __m128i t = _mm_add_epi8(pos, shift);
+        t = _mm_min_epu8(t, _mm_sub_epi8(t, twenty_six));
+        __m128i shifted = _mm_add_epi8(t, upper_a);
+
+        c = _mm_blendv_epi8(c, shifted, is_letter);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), c);
+
+        if constexpr (!Caesar) {
+            phase += __builtin_popcount(_mm_movemask_epi8(is_letter));
+            if (phase >= schedule.period) phase -= schedule.period;
+        }
+    }
+
+    if constexpr (Caesar) {
+        shift_scalar_fixed<1>(data + i, length - i, schedule, phase);
+    } else {
+        shift_scalar(data + i, length - i, schedule, phase);
+    }
+}
+
+
+template <bool Caesar>
+__attribute__((target("avx2")))
+inline void shift_avx2(uint8_t* data, size_t length, const ShiftSchedule& schedule,
+                       size_t& phase) {
+    const uint8_t* shifts = schedule.shifts.data();
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i letter_a = _mm256_set1_epi8('a');
+    const __m256i upper_a = _mm256_set1_epi8('A');
+    const __m256i max_pos = _mm256_set1_epi8(25);
+    const __m256i twenty_six = _mm256_set1_epi8(26);
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i caesar_shift = _mm256_set1_epi8(static_cast<char>(shifts[0]));
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+
+        __m256i pos = _mm256_sub_epi8(_mm256_or_si256(c, case_bit), letter_a);
+        __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(pos, max_pos), pos);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(is_letter));
+
+        __m256i shift = caesar_shift;
+        if constexpr (!Caesar) {
+            // AVX2 byte shifts and shuffles work on each 16-byte half separately,
+            // so the prefix sum restarts at the upper half. The upper half gets
+            // its own schedule window, starting after the lower half's letters.
+            __m256i ones = _mm256_and_si256(is_letter, one);
+            __m256i before = _mm256_add_epi8(ones, _mm256_slli_si256(ones, 1));
+            before = _mm256_add_epi8(before, _mm256_slli_si256(before, 2));
+            before = _mm256_add_epi8(before, _mm256_slli_si256(before, 4));
+            before = _mm256_add_epi8(before, _mm256_slli_si256(before, 8));
+            before = _mm256_sub_epi8(before, ones);
+
+            size_t upper_phase = phase + __builtin_popcount(mask & 0xFFFF);
+            __m256i window = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(shifts + phase))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(shifts + upper_phase)), 1);
+            shift = _mm256_shuffle_epi8(window, before);
+        }
+
+        __m256i t = _mm256_add_epi8(pos, shift);
+        t = _mm256_min_epu8(t, _mm256_sub_epi8(t, twenty_six));
+        __m256i shifted = _mm256_add_epi8(t, upper_a);
+
+        c = _mm256_blendv_epi8(c, shifted, is_letter);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), c);
+
+        if constexpr (!Caesar) {
+            phase += __builtin_popcount(mask);
+            if (phase >= schedule.period) phase -= schedule.period;
+        }
+    }
+
+    shift_sse42<Caesar>(data + i, length - i, schedule, phase);
+}
+
+#endif  // SHIFT_KERNEL_X86
+
+
+// ============================================================================
+// ARM KERNEL - NEON
+// ============================================================================
+
+#ifdef SHIFT_KERNEL_NEON
+
+template <bool Caesar>
+inline void shift_neon(uint8_t* data, size_t length, const ShiftSchedule& schedule,
+                       size_t& phase) {
+    const uint8_t* shifts = schedule.shifts.data();
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    const uint8x16_t caesar_shift = vdupq_n_u8(shifts[0]);
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t c = vld1q_u8(data + i);
+
+        uint8x16_t pos = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+        uint8x16_t is_letter = vcleq_u8(pos, vdupq_n_u8(25));
+
+        uint8x16_t shift = caesar_shift;
+        uint8x16_t ones = vandq_u8(is_letter, one);
+        if constexpr (!Caesar) {
+            // vextq_u8(zero, x, 16 - k) moves every byte k lanes up
+            uint8x16_t before = vaddq_u8(ones, vextq_u8(zero, ones, 15));
+            before = vaddq_u8(before, vextq_u8(zero, before, 14));
+            before = vaddq_u8(before, vextq_u8(zero, before, 12));
+            before = vaddq_u8(before, vextq_u8(zero, before, 8));
+            before = vsubq_u8(before, ones);
+
+            shift = vqtbl1q_u8(vld1q_u8(shifts + phase), before);
+        }
+
+        uint8x16_t t = vaddq_u8(pos, shift);
+        t = vminq_u8(t, vsubq_u8(t, vdupq_n_u8(26)));
+        uint8x16_t shifted = vaddq_u8(t, vdupq_n_u8('A'));
+
+        vst1q_u8(data + i, vbslq_u8(is_letter, shifted, c));
+
+        if constexpr (!Caesar) {
+            phase += vaddvq_u8(ones);
+            if (phase >= schedule.period) phase -= schedule.period;
+        }
+    }
+
+    if constexpr (Caesar) {
+        shift_scalar_fixed<1>(data + i, length - i, schedule, phase);
+    } else {
+        shift_scalar(data + i, length - i, schedule, phase);
+    }
+}
+
+#endif  // SHIFT_KERNEL_NEON
+
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+typedef void (*ShiftKernel)(uint8_t*, size_t, const ShiftSchedule&, size_t&);
+
+
+// Longest key with its own scalar instantiation
+const size_t MAX_FIXED_KEY = 16;
+
+
+// shift_scalar_fixed<1> .. shift_scalar_fixed<MAX_FIXED_KEY>, by key length - 1
+
+template <size_t... Index>
+constexpr std::array<ShiftKernel, sizeof...(Index)> fixed_scalar_kernels(std::index_sequence<Index...>) {
+    return {{shift_scalar_fixed<Index + 1>...}};
+}
+
+inline constexpr std::array<ShiftKernel, MAX_FIXED_KEY> FIXED_SCALAR_KERNELS =
+    fixed_scalar_kernels(std::make_index_sequence<MAX_FIXED_KEY>());
+
+
+// Which instruction set this CPU supports, checked once
+
+enum class ShiftIsa { SCALAR, SSE42, AVX2, NEON };
+
+inline ShiftIsa detect_shift_isa() {
+    static const ShiftIsa isa = []() {
+#if defined(SHIFT_KERNEL_X86)
+        if (__builtin_cpu_supports("avx2")) return ShiftIsa::AVX2;
+        if (__builtin_cpu_supports("sse4.2")) return ShiftIsa::SSE42;
+        return ShiftIsa::SCALAR;
+#elif defined(SHIFT_KERNEL_NEON)
+        return ShiftIsa::NEON;
+#else
+        return ShiftIsa::SCALAR;
+#endif
+    }();
+    return isa;
+}
+
+
+// Picks the fastest kernel for this CPU and key length
+// Vector kernels come in two instantiations (Caesar or any key); without
+// them, keys up to MAX_FIXED_KEY letters get their own scalar kernel
+
+inline ShiftKernel select_shift_kernel(size_t key_length) {
+    [[maybe_unused]] bool caesar = key_length == 1;
+
+    switch (detect_shift_isa()) {
+#if defined(SHIFT_KERNEL_X86)
+        case ShiftIsa::AVX2:  return caesar ? shift_avx2<true> : shift_avx2<false>;
+        case ShiftIsa::SSE42: return caesar ? shift_sse42<true> : shift_sse42<false>;
+#elif defined(SHIFT_KERNEL_NEON)
+        case ShiftIsa::NEON:  return caesar ? shift_neon<true> : shift_neon<false>;
+#endif
+        default:
+            break;
+    }
+
+    return key_length <= MAX_FIXED_KEY ? FIXED_SCALAR_KERNELS[key_length - 1] : shift_scalar;
+}
+
+
+// Shifts every letter of a buffer in place
+// key_pos: the key phase (0..period-1) the buffer starts at. Any larger
+//          value is taken mod schedule.period. On return it is the phase
+//          after the buffer, so the next buffer continues the key
+
+inline void apply_schedule(char* data, size_t length, const ShiftSchedule& schedule,
+                           size_t& key_pos) {
+    // Beaufort (k - p) is a Vigenère shift of the negated letters: one
+    // table pass first, then the same kernels as everything else
+    if (schedule.reflect) {
+        const uint8_t* reflect = TRANSLATION_TABLES.reflect;
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(data);
+        for (size_t i = 0; i < length; i++) bytes[i] = reflect[bytes[i]];
+    }
+
+    size_t phase = key_pos % schedule.period;
+    select_shift_kernel(schedule.key_length)(reinterpret_cast<uint8_t*>(data), length,
+                                             schedule, phase);
+    key_pos = phase;
+}
+
+
+
+// ============================================================================
+// MULTITHREADED - Two passes with key-phase alignment
+// ============================================================================
+// Caesar slices are independent, but a Vigenère slice can only start once
+// we know which key letter it starts on - and the key only advances on
+// letters. So:
+//   Pass 1: every thread counts the letters in its slice
+//   Prefix sum: slice k starts at key_pos + letters in slices 0..k-1
+//   Pass 2: every thread shifts its slice starting at that phase
+// The output is byte-identical to processing the buffer on one thread.
+
+// Counts the letters in a buffer, using the same test as the kernels
+// Simple enough for the compiler to auto-vectorize
+
+inline size_t count_letter_bytes(const char* data, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++) {
+        count += static_cast<uint8_t>((data[i] | 0x20) - 'a') < 26;
+    }
+    return count;
+}
+
+
+// Shifts a buffer in place on the pool's workers plus the calling thread
+// (nullptr = the calling thread alone). The pool is made once per run and
+// reused for every buffer, so a stream of blocks doesn't start threads
+// for each one. Small buffers aren't worth splitting and use one thread
+
+inline void apply_schedule_parallel(char* data, size_t length, const ShiftSchedule& schedule,
+                                    size_t& key_pos, TaskPool* pool) {
+    const size_t MIN_SLICE = 64 * 1024;
+
+    size_t threads = pool != nullptr ? pool->size() + 1 : 1;
+    threads = std::min(threads, length / MIN_SLICE);
+    if (threads <= 1 || pool == nullptr) {
+        apply_schedule(data, length, schedule, key_pos);
+        return;
+    }
+
+    size_t slice = (length + threads - 1) / threads;
+    auto slice_begin = [&](size_t k) { return std::min(length, k * slice); };
+
+    // Pass 1: letters per slice (Caesar doesn't care where a slice starts)
+    std::vector<size_t> letters(threads, 0);
+
+    if (schedule.key_length > 1) {
+        pool->parallel_for(threads, [&](size_t k) {
+            size_t begin = slice_begin(k);
+            letters[k] = count_letter_bytes(data + begin, slice_begin(k + 1) - begin);
+        });
+    }
+
+    // Prefix sum: the key phase each slice starts at
+    std::vector<size_t> start_phase(threads);
+    size_t phase = key_pos % schedule.period;
+
+    for (size_t k = 0; k < threads; k++) {
+        start_phase[k] = phase;
+        phase = (phase + letters[k]) % schedule.period;
+    }
+
+    // Pass 2: shift all slices at once
+    pool->parallel_for(threads, [&](size_t k) {
+        size_t begin = slice_begin(k);
+        size_t slice_phase = start_phase[k];
+        apply_schedule(data + begin, slice_begin(k + 1) - begin, schedule, slice_phase);
+    });
+
+    key_pos = phase;
+}
+
+#endif  // SHIFT_KERNEL_H
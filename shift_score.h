@@ -0,0 +1,104 @@
+// ============================================================================
+// SHIFT SCORE - How English Does a Caesar Shift Look?
+// ============================================================================
+// The scoring both Caesar cracking (caesar.cpp crack) and every column of
+// the Vigenère attack (kasiski.h) use: English letter frequencies, the
+// chi-squared test against them, and best_shift, which picks the best of
+// the 26 shifts straight from a histogram. Small on purpose - caesar only
+// needs this, not the whole attack.
+// ============================================================================
+
+#ifndef SHIFT_SCORE_H
+#define SHIFT_SCORE_H
+
+#include <cstdint>
+
+#include "kasiski_stats.h"
+
+
+// Expected letter frequencies in English (as percentages)
+// E is most common at 13%, Z is least common at 0.07%
+
+const double ENGLISH_FREQ[26] = {
+    8.2, 1.5, 2.8, 4.3, 13.0, 2.2, 2.0, 6.1, 7.0, 0.15, 0.77, 4.0, 2.4,
+    6.7, 7.5, 1.9, 0.095, 6.0, 6.3, 9.1, 2.8, 0.98, 2.4, 0.15, 2.0, 0.074
+};
+
+
+// Calculate chi-squared statistic
+// Measures how well observed frequencies match expected frequencies
+// Lower chi-squared = better match to English
+
+inline double chi_squared(const double observed[26], const double expected[26]) {
+    double chi2 = 0.0;
+
+    for (int i = 0; i < 26; i++) {
+        if (expected[i] > 0) {
+            double diff = observed[i] - expected[i];
+            chi2 += (diff * diff) / expected[i];
+        }
+    }
+
+    return chi2;
+}
+
+
+// How break_caesar_shift judges each of the 26 shifts
+//   CHI_SQUARED: lowest chi-squared against ENGLISH_FREQ wins
+//   CORRELATION: highest cyclic cross-correlation with ENGLISH_FREQ wins
+//                (Σ observed × expected - no division, more forgiving
+//                 of rare letters in short columns)
+//   QUADGRAM:    chi-squared per column, then the whole key is refined
+//                with quadgram fitness (refine_key_quadgrams). A single
+//                column has no letter order, so on its own it scores as
+//                CHI_SQUARED
+
+enum class ShiftScore { CHI_SQUARED, CORRELATION, QUADGRAM };
+
+
+// Finds the best Caesar shift from a column's letter counts
+//
+// Decrypting with shift s turns ciphertext letter (j + s) into plaintext
+// letter j - so the decrypted histogram is just the ciphertext histogram
+// rotated by s. No need to decrypt anything: one count pass, then 26
+// rotations × 26 letters of arithmetic.
+//
+// The correlation score is the cyclic cross-correlation of the histogram
+// with ENGLISH_FREQ. With only 26 bins, computing all 26 lags directly
+// (676 multiply-adds) is cheaper than going through an FFT.
+
+inline int best_shift(const uint64_t counts[26], ShiftScore method = ShiftScore::CHI_SQUARED) {
+    KASISKI_COUNT(COLUMNS_SCORED, 1);
+    uint64_t total = 0;
+    for (int i = 0; i < 26; i++) total += counts[i];
+
+    double best_score = 0.0;
+    int best = 0;
+
+    for (int shift = 0; shift < 26; shift++) {
+        double score = 0.0;
+
+        if (method != ShiftScore::CORRELATION) {
+            // Same numbers calculate_frequencies + chi_squared would give
+            double freq[26];
+            for (int j = 0; j < 26; j++) {
+                uint64_t count = counts[(j + shift) % 26];
+                freq[j] = total > 0 ? (count * 100.0) / total : 0.0;
+            }
+            score = -chi_squared(freq, ENGLISH_FREQ);  // Lower chi2 = better
+        } else {
+            for (int j = 0; j < 26; j++) {
+                score += counts[(j + shift) % 26] * ENGLISH_FREQ[j];
+            }
+        }
+
+        if (shift == 0 || score > best_score) {
+            best_score = score;
+            best = shift;
+        }
+    }
+
+    return best;
+}
+
+#endif  // SHIFT_SCORE_H
@@ -0,0 +1,210 @@
+// ============================================================================
+// TASK POOL - Work-stealing thread pool
+// ============================================================================
+// Every worker thread has its own queue of tasks:
+//   - A worker pushes new tasks onto the back of its own queue and takes
+//     work from the back too (newest first - its data is still in cache)
+//   - A worker with nothing to do steals from the FRONT of someone else's
+//     queue (oldest first - usually the biggest chunk of remaining work)
+// So a long job that splits itself into subtasks gets help from idle
+// workers, and short jobs don't sit behind it in one shared line.
+//
+// Threads that wait for results (parallel_for, wait_until) run pending
+// tasks while they wait, so a task can safely wait on its own subtasks.
+// ============================================================================
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class TaskPool {
+public:
+    // Starts `threads` workers (0 = run everything on the waiting threads)
+    explicit TaskPool(unsigned threads) {
+        unsigned queues = std::max(1u, threads);
+        for (unsigned i = 0; i < queues; i++) {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 0; i < threads; i++) {
+            workers_.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) worker.join();
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+
+    // Queues a task
+    // From a worker it goes on that worker's own queue, otherwise the
+    // queues take turns
+    void submit(std::function<void()> task) {
+        size_t index = current_worker() >= 0
+                           ? static_cast<size_t>(current_worker())
+                           : next_queue_++ % queues_.size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            queued_++;
+        }
+        wake_.notify_one();
+    }
+
+
+    // Runs one pending task on the calling thread, if there is one
+    // Returns false if every queue was empty
+    bool run_one() {
+        std::function<void()> task;
+        if (!take(current_worker(), task)) return false;
+        run(task);
+        return true;
+    }
+
+
+    // Blocks until done() returns true, running pending tasks meanwhile
+    template <typename Predicate>
+    void wait_until(Predicate done) {
+        while (!done()) {
+            if (run_one()) continue;
+
+            // Nothing to run: sleep until some task finishes
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            finished_.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+
+    // Runs body(i) for every i in [0, count) across the pool
+    // The calling thread does its share and returns when all are done
+    template <typename Body>
+    void parallel_for(size_t count, Body&& body) {
+        if (count == 0) return;
+
+        std::atomic<size_t> done{0};
+        for (size_t i = 1; i < count; i++) {
+            submit([&body, &done, i]() {
+                body(i);
+                done++;
+            });
+        }
+
+        body(0);
+        done++;
+
+        wait_until([&]() { return done.load() == count; });
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+
+    // Which worker of this pool the calling thread is (-1 = not a worker)
+    int current_worker() const {
+        return worker_pool_ == this ? worker_index_ : -1;
+    }
+
+
+    // Own queue from the back, then steal from the front of the others
+    bool take(int self, std::function<void()>& task) {
+        size_t n = queues_.size();
+
+        if (self >= 0 && pop(*queues_[self], task, true)) return true;
+
+        size_t start = self >= 0 ? self + 1 : next_queue_.load();
+        for (size_t k = 0; k < n; k++) {
+            size_t index = (start + k) % n;
+            if (static_cast<int>(index) != self && pop(*queues_[index], task, false)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    bool pop(Queue& queue, std::function<void()>& task, bool from_back) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+
+        if (from_back) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        std::lock_guard<std::mutex> sleep_lock(sleep_mutex_);
+        queued_--;
+        return true;
+    }
+
+
+    void run(std::function<void()>& task) {
+        task();
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        finished_.notify_all();
+    }
+
+
+    void worker_loop(unsigned index) {
+        worker_pool_ = this;
+        worker_index_ = static_cast<int>(index);
+
+        while (true) {
+            std::function<void()> task;
+            if (take(worker_index_, task)) {
+                run(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_.wait(lock, [this]() { return stopping_ || queued_ > 0; });
+            if (stopping_ && queued_ == 0) return;
+        }
+    }
+
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_{0};
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;      // Signalled when a task is queued
+    std::condition_variable finished_;  // Signalled when a task finishes
+    size_t queued_ = 0;                 // Tasks waiting in queues (under sleep_mutex_)
+    bool stopping_ = false;
+
+    static inline thread_local const TaskPool* worker_pool_ = nullptr;
+    static inline thread_local int worker_index_ = -1;
+};
+
+#endif  // TASK_POOL_H
@@ -1,105 +1,73 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
+#include <vector>
 #include <cctype>
+#include "cipher.h"
 
-// Internal function that performs Vigenère encryption or decryption
-// Parameters:
-//   text: the message to process
-//   key: the keyword (e.g., "CAB")
-//   direction: +1 for encryption, -1 for decryption
-// Returns: the processed text (all uppercase, non-letters unchanged)
-std::string vigenere_process(const std::string& text, const std::string& key, int direction) {
-    std::string result = text;
-    int key_pos = 0;  // Tracks position in key, only advances for letters
-    
-    for (char& c : result) {
-        if (std::isalpha(c)) {
-            // Step 1: Convert plaintext letter to uppercase
-            c = std::toupper(c);
-            
-            // Step 2: Get the corresponding key letter for this position
-            // Use modulo to wrap around if key is shorter than text
-            // Example: key "CAB" (length 3), position 5 → key[5 % 3] = key[2] = 'B'
-            char key_letter = std::toupper(key[key_pos % key.length()]);
-            
-            // Step 3: Convert key letter to a shift amount (0-25)
-            // 'A' → 0, 'B' → 1, 'C' → 2, etc.
-            int shift = key_letter - 'A';
-            
-            // Step 4: Convert plaintext letter to position (0-25)
-            // 'A' → 0, 'B' → 1, ..., 'Z' → 25
-            int pos = c - 'A';
-            
-            // Step 5: Apply the cipher transformation
-            // - For encryption (direction = 1): add the shift
-            //   Example: 'S'(18) + shift 2 = 20 → 'U'
-            // - For decryption (direction = -1): subtract the shift
-            //   Example: 'U'(20) - shift 2 = 18 → 'S'
-            // - The +26 ensures we never get negative numbers before modulo
-            //   Example: 'B'(1) - shift 3 = -2, but (-2 + 26) % 26 = 24 → 'Y'
-            // - The % 26 wraps around the alphabet
-            //   Example: 'Y'(24) + shift 3 = 27, but 27 % 26 = 1 → 'B'
-            pos = (pos + direction * shift + 26) % 26;
-            
-            // Step 6: Convert position back to a letter
-            // 0 → 'A', 1 → 'B', etc.
-            c = pos + 'A';
-            
-            // Step 7: Move to next position in key (only for letters)
-            key_pos++;
-        }
-        // Non-alphabetic characters (spaces, punctuation) are left unchanged
-        // and do NOT advance the key position
-    }
-    
-    return result;
-}
-
-// Public wrapper for encryption
-// Calls vigenere_process with direction = +1
-std::string vigenere_encrypt(const std::string& text, const std::string& key) {
-    return vigenere_process(text, key, 1);
-}
-
-// Public wrapper for decryption
-// Calls vigenere_process with direction = -1
-std::string vigenere_decrypt(const std::string& text, const std::string& key) {
-    return vigenere_process(text, key, -1);
-}
-
-std::string read_file(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file " << filename << std::endl;
-        exit(1);
-    }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-
-void write_file(const std::string& filename, const std::string& content) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not write to file " << filename << std::endl;
-        exit(1);
-    }
-    
-    file << content;
-}
+// How Vigenère encryption and decryption work, for each letter:
+//   1. Uppercase it and turn it into a position 0-25 ('A' → 0, 'B' → 1, ...)
+//   2. Take the key letter for this position, wrapping around the key
+//      Example: key "CAB" (length 3), letter 5 → key[5 % 3] = key[2] = 'B'
+//   3. Add the key letter's shift for encryption ('S'(18) + 'C'(2) = 'U'),
+//      subtract it for decryption, and wrap around the alphabet
+//   4. Advance the key position - only for letters! Spaces and punctuation
+//      are left unchanged and do NOT use up a key letter
+//
+// make_schedule precomputes the shift of every key position, and the SIMD
+// kernels in shift_kernel.h do the work 16-32 letters at a time. The
+// cipher (vigenere_encrypt/decrypt, transform) and the file handling
+// (stream_file, mmap_file, transform_in_place) live in cipher.h, shared
+// with caesar.cpp.
+//
+// --variant picks another member of the family (see VARIANTS in cipher.h):
+//   beaufort, variant-beaufort - same kernels, every file mode and --threads
+//   autokey                    - <key> is the primer; one thread only
+//   running-key                - <key> is a file of key text, e.g. a book;
+//                                its letters are the key, and there must
+//                                be at least as many as in the input
 
 int main(int argc, char* argv[]) {
     if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <encrypt|decrypt> <filename> <key>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <encrypt|decrypt> <filename> <key> [--variant NAME] [--threads N] [--mmap] [--in-place] [--compress gzip|zstd]\n"
+                  << "       NAME: vigenere (default), beaufort, variant-beaufort, autokey, running-key\n"
+                  << "       With running-key, <key> is a file whose letters are the key\n"
+                  << "       With autokey, <key> is the primer, and it runs on one thread (no --threads)" << std::endl;
         return 1;
     }
     
     std::string mode = argv[1];
     std::string input_filename = argv[2];
     std::string key = argv[3];
+
+    // Optional flags after the key; --variant is vigenere's own
+    CipherVariant variant = CipherVariant::VIGENERE;
+    std::vector<char*> args(argv, argv + 4);
+    for (int i = 4; i < argc; i++) {
+        if (std::string(argv[i]) == "--variant" && i + 1 < argc) {
+            if (!parse_variant(argv[++i], variant)) {
+                std::cerr << "Error: unknown variant " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    FileOptions options = parse_file_options(static_cast<int>(args.size()), args.data(), 4);
+
+    // Each autokey shift depends on the letters before it, so one thread
+    // does all of it
+    if (variant == CipherVariant::AUTOKEY && options.threads > 1) {
+        std::cerr << "Warning: autokey runs on one thread, ignoring --threads "
+                  << options.threads << std::endl;
+    }
+
+    // A running key is the letters of a whole file
+    std::string key_source = key;
+    if (variant == CipherVariant::RUNNING_KEY) {
+        MappedInput key_file(key_source);
+        key.assign(key_file.size(), '\0');
+        key.resize(clean_letters(key_file.view(), key));
+    }
     
     if (key.empty()) {
         std::cerr << "Error: key cannot be empty" << std::endl;
@@ -112,28 +80,60 @@ int main(int argc, char* argv[]) {
             return 1;
         }
     }
+
+    // A running key shorter than the text would wrap around and repeat -
+    // an ordinary (long) Vigenère key, which the Kasiski attack breaks
+    if (variant == CipherVariant::RUNNING_KEY) {
+        uint64_t counts[26];
+        count_file_letters(input_filename, counts, options.threads);
+        uint64_t letters = 0;
+        for (uint64_t count : counts) letters += count;
+
+        if (key.size() < letters) {
+            std::cerr << "Error: the running key of " << key_source << " has " << key.size()
+                      << " letters, but " << input_filename << " has " << letters
+                      << " - the key would repeat" << std::endl;
+            return 1;
+        }
+    }
     
-    std::string content = read_file(input_filename);
-    
-    std::string processed;
+    int direction;
     std::string output_prefix;
     
     if (mode == "encrypt") {
-        processed = vigenere_encrypt(content, key);
+        direction = 1;
         output_prefix = "encrypted_";
     } else if (mode == "decrypt") {
-        processed = vigenere_decrypt(content, key);
+        direction = -1;
         output_prefix = "decrypted_";
     } else {
         std::cerr << "Error: mode must be 'encrypt' or 'decrypt'" << std::endl;
         return 1;
     }
     
-    std::string output_filename = output_prefix + input_filename;
-    write_file(output_filename, processed);
+    std::string output_filename = output_file_name(input_filename, output_prefix, options);
+
+    if (variant == CipherVariant::AUTOKEY) {
+        autokey_file(input_filename, output_filename, make_autokey(key, direction), options);
+    } else if (options.in_place) {
+        transform_in_place(input_filename, make_variant_schedule(variant, key, direction),
+                           options.threads);
+    } else if (options.use_mmap) {
+        mmap_file(input_filename, output_filename, make_variant_schedule(variant, key, direction),
+                  options.threads);
+    } else {
+        stream_file(input_filename, output_filename, make_variant_schedule(variant, key, direction),
+                    options.threads);
+    }
     
-    std::cout << "Processed " << input_filename << " in " << mode << " mode with key '" 
-              << key << "'" << std::endl;
+    std::cout << "Processed " << input_filename << " in " << mode << " mode with ";
+    if (variant == CipherVariant::RUNNING_KEY) {
+        std::cout << "the running key of " << key_source << " (" << key.size() << " letters)";
+    } else {
+        std::cout << "key '" << key << "'";
+    }
+    if (variant != CipherVariant::VIGENERE) std::cout << " (" << variant_name(variant) << ")";
+    std::cout << std::endl;
     std::cout << "Output written to " << output_filename << std::endl;
     
     return 0;